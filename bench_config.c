@@ -0,0 +1,66 @@
+// make bench_config && ./bench_config [path]
+// loads one section in the middle of a 50 MB INI file with 'shop_load_file'
+
+#define _POSIX_C_SOURCE 200809L
+#define SHOP_IMPLEMENTATION
+#include "shop.h"
+#include <time.h>
+
+#define SECTIONS 52000
+#define RUNS     10
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1e3 + ts.tv_nsec/1e6;
+}
+
+// sections of about 1 KB, the section 'target' sits in the middle
+static size_t write_config(const char *path, long *size) {
+    FILE *f = fopen(path, "w");
+    if (!f) return 0;
+    size_t lines = 0;
+    for (int s = 0; s < SECTIONS; s++) {
+        if (s == SECTIONS/2) fprintf(f, "[target]\n");
+        else fprintf(f, "[section%d]\n", s);
+        fprintf(f, "; generated by bench_config\n");
+        for (int k = 0; k < 20; k++) fprintf(f, "key%d = value %d of section %d, padded to 50 MB\n", k, k, s);
+        fprintf(f, "n = %d\nf = file%d.txt\n", s, s);
+        lines += 24;
+    }
+    *size = ftell(f);
+    fclose(f);
+    return lines;
+}
+
+int main(int argc, char **argv) {
+    const char *path = argc > 1 ? argv[1] : "bench_config.ini";
+    long size = 0;
+    size_t lines = write_config(path, &size);
+    if (!lines) {
+        fprintf(stderr, "can not write '%s'\n", path);
+        return 1;
+    }
+
+    double best = 1e9, total = 0;
+    int n = 0;
+    for (int r = 0; r < RUNS; r++) {
+        shop_set("n:f:");
+        shop_desc('n', "%d", "Number");
+        double t = now_ms();
+        if (!shop_load_file(path, "target")) {
+            fprintf(stderr, "can not read '%s'\n", path);
+            return 1;
+        }
+        t = now_ms() - t;
+        shop_sget('n', 0, &n);
+        shop_free();
+        total += t;
+        if (t < best) best = t;
+    }
+
+    printf("%.1f MB, %zu lines, %d sections: best %.2f ms, mean %.2f ms per load (n = %d)\n",
+           size/1048576.0, lines, SECTIONS, best, total/RUNS, n);
+    remove(path);
+    return n == SECTIONS/2 ? 0 : 1;
+}
@@ -0,0 +1,59 @@
+// make bench_track && ./bench_track [nargs]
+// times 'shop_track' of a large argv with 'shop_threads' from 1 to 32,
+// the first run of each count starts the pool workers it needs
+
+#define _POSIX_C_SOURCE 200809L
+#define SHOP_IMPLEMENTATION
+#include "shop.h"
+#include <time.h>
+
+#define RUNS 3
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1e3 + ts.tv_nsec/1e6;
+}
+
+int main(int argc, char **argv) {
+    int n = argc > 1 ? atoi(argv[1]) : 10000000;
+    if (n < 2) n = 2;
+
+    // flags, split values and attached values, like '-v -n 12345 -fdata'
+    char **args = (char **) malloc((size_t) (n + 1)*sizeof(char *));
+    if (!args) return 1;
+    args[0] = "bench_track";
+    for (int i = 1; i < n; i++) {
+        switch (i % 4) {
+        case 0: args[i] = "-v"; break;
+        case 1: args[i] = "-n"; break;
+        case 2: args[i] = "12345"; break;
+        default: args[i] = "-fdata"; break;
+        }
+    }
+    args[n] = NULL;
+
+    const int threads[] = { 1, 2, 4, 8, 16, 32 };
+    double base = 0;
+    for (size_t k = 0; k < sizeof(threads)/sizeof(threads[0]); k++) {
+        double first = 0, best = 1e9;
+        size_t len = 0;
+        for (int r = 0; r < RUNS; r++) {
+            shop_set("vn:f:");
+            shop_threads(threads[k]);
+            double t = now_ms();
+            shop_track(n, args);
+            t = now_ms() - t;
+            len = shop_len('n');
+            shop_free();
+            if (r == 0) first = t;
+            if (t < best) best = t;
+        }
+        if (k == 0) base = best;
+        printf("threads %2d: first %8.1f ms, best %8.1f ms, speedup %.2fx (%zu values of -n)\n",
+               threads[k], first, best, base/best, len);
+    }
+
+    free(args);
+    return 0;
+}
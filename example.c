@@ -6,6 +6,10 @@
 #define SHOP_IMPLEMENTATION
 #include "shop.h"
 
+// an option defined away from 'shop_set', registered by 'shop_set' below
+static bool quiet = false;
+SHOP_DEFINE('q', false, NULL, "Quiet mode (defined with SHOP_DEFINE)", &quiet);
+
 int main(int argc, char **argv) {
     shop_set("vn:f:b:p:h");
 
@@ -16,6 +20,11 @@ int main(int argc, char **argv) {
     shop_desc('b', "%b", "Boolean flag");
     shop_desc('p', "%f", "Float point");
 
+    struct { bool verbose; int number; } cfg = { false, 0 };
+    shop_bind('v', &cfg.verbose, NULL);
+    shop_bind('n', &cfg.number, NULL);
+    shop_default('n', "-1");
+
     shop_track(argc, argv);
 
     // test help
@@ -54,6 +63,12 @@ int main(int argc, char **argv) {
         printf("Double value: %.2f\n", value);
     }
 
+    // test bind
+    printf("Config: verbose=%s number=%d\n", cfg.verbose ? "true" : "false", cfg.number);
+
+    // test define
+    if (quiet) printf("Quiet mode\n");
+
     // test unknown
     if (!shop_use('x')) {
         printf("Option -x not used\n");
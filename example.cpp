@@ -0,0 +1,66 @@
+// ./example_cpp -h
+// ./example_cpp -v -n 42 -f data.txt -b true -p 3.14
+// ./example_cpp -vn 42 -fdata.txt -b1 -p2.5
+// ./example_cpp -n 1 -n 2 -n 3 -f a.txt -f b.txt
+
+#define SHOP_IMPLEMENTATION
+#include "shop.hpp"
+
+static constexpr char opts[] = "vn:f:b:p:h";
+static constexpr char fmts[] = "n%d f%s b%b p%f";
+
+int main(int argc, char **argv) {
+    shop::parser<opts, fmts> p;
+    p.track(argc, argv);
+
+    // test help
+    if (p.use<'h'>()) {
+        printf("usage: %s [-v] [-n int] [-f file] [-b bool] [-p float] [-h]\n", argv[0]);
+        return 0;
+    }
+
+    printf("=== Parsing Results ===\n");
+
+    if (p.use<'v'>()) {
+        printf("Verbose mode\n");
+    }
+
+    // test number
+    if (auto number = p.get<'n', int>()) {
+        printf("Number: %d\n", *number);
+    }
+
+    // test string
+    for (std::size_t i = 0; i < p.len<'f'>(); i++) {
+        printf("Filename[%zu]: %s\n", i, *p.get<'f', const char *>(i));
+    }
+
+    // test flag
+    for (std::size_t i = 0; i < p.len<'b'>(); i++) {
+        printf("Boolean flag[%zu]: %s\n", i, *p.get<'b', bool>(i) ? "true" : "false");
+    }
+
+    // test float
+    if (auto value = p.get<'p', float>()) {
+        printf("Float value: %.2f\n", *value);
+    }
+
+    // p.get<'x', int>() or p.get<'n', double>() would not compile
+
+    // the same through the runtime wrapper
+    shop::options o("vn:f:b:p:h");
+    o.desc('n', "%d", "Number (int)")
+     .desc('f', "%s", "Filename (string)");
+    o.track(argc, argv);
+
+    int sum = 0;
+    for (int n : o.values<int>('n')) sum += n;
+    printf("Sum of numbers: %d\n", sum);
+
+    for (std::size_t i = 0; i < o.len('f'); i++) {
+        std::string_view file = o.value('f', i);
+        printf("Filename[%zu]: %.*s\n", i, (int) file.size(), file.data());
+    }
+
+    return 0;
+}
@@ -7,7 +7,7 @@ BRIEF:
   option, like '-h'.
 
 NOTICE:
-  Not compatible with C++.
+  Compiles as C++ too. 'shop.hpp' has the C++ front ends.
 
 USAGE:
   In exactly one source file, define the implementation macro
@@ -29,6 +29,10 @@ int main(int argc, char **argv) {
     shop_desc('f', "%s", "Filename (string)");
     shop_desc('n', "%d", "Number (int)");
 
+    // or write the last value into a variable while tracking
+    bool verbose = false;
+    shop_bind('v', &verbose, NULL);
+
     shop_track(argc, argv);
 
     // get the option items
@@ -42,6 +46,9 @@ int main(int argc, char **argv) {
         printf("Number[%ld]: %d\n", i, number);
     }
 
+    // C11: the converter is picked by the type of '&number'
+    if (shop_get('n', 0, &number)) { ... }
+
     // option callback
     const shop_option_t *opt_ptr;
     if (shop_use('h')) shop_help();
@@ -52,6 +59,19 @@ int main(int argc, char **argv) {
 }
 ```
 
+CONTEXT:
+  All functions work on the current context. Switch to your own
+  one to keep several option tables at the same time:
+  ```
+    shop_ctx_t ctx = {0};
+    shop_ctx_t *prev = shop_switch(&ctx);
+    shop_set("vn:");
+    shop_track(argc, argv);
+    ...
+    shop_free();
+    shop_switch(prev);
+  ```
+
 HISTORY:
     v0.2.0 (2026-1-1 by @dylaris): repeat options for multiple values:
                                    ```
@@ -72,22 +92,131 @@ LICENSE:
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <limits.h>
+#include <errno.h>
 
 #ifndef SHOPDEF
 #define SHOPDEF
 #endif
 
+// value types, resolved from the scan format by 'shop_desc'
+typedef enum {
+    SHOP_NONE,   // no scan format
+    SHOP_SCANF,  // other scan formats, converted by 'sscanf'
+    SHOP_STR,    // "%s",  const char *
+    SHOP_BOOL,   // "%b",  bool
+    SHOP_INT,    // "%d",  int
+    SHOP_LONG,   // "%ld", long
+    SHOP_FLOAT,  // "%f",  float
+    SHOP_DOUBLE, // "%lf", double
+    SHOP_SIZE,   // "%size", uint64_t bytes, like '64K' or '1.5GiB'
+    SHOP_DUR,    // "%dur", uint64_t nanoseconds, like '250ms' or '1h30m'
+    SHOP_RATE,   // "%rate", shop_rate_t, like '10k/s' or '300/5m'
+    SHOP_CHOICE, // int id of the value, see 'shop_choices'
+    SHOP_RANGE,  // "%range", long, like '0-15,32-47', see 'shop_len'
+    SHOP_DICT,   // "%dict", 'key=value' per occurrence, see 'shop_dict_get'
+    SHOP_SUBOPT, // "%subopt", 'a=1,b=2' like getsubopt, see 'shop_dict_get'
+    SHOP_USER,   // first id of 'shop_register_type'
+} shop_type_t;
+
+// value of "%rate": 'count' events per 'per_ns' nanoseconds
+typedef struct {
+    uint64_t count;
+    uint64_t per_ns;
+} shop_rate_t;
+
+// how the occurrences of an option are kept, see 'shop_mode'
+typedef enum {
+    SHOP_APPEND, // keep every value (default)
+    SHOP_LAST,   // keep the last value only
+    SHOP_FIRST,  // keep the first value only
+    SHOP_COUNT,  // keep no value, only count the occurrences, like '-vvv'
+    SHOP_MERGE,  // keep every value of every source, see 'shop_flatten'
+} shop_mode_t;
+
+// sources of option values, a later one wins over an earlier one
+typedef enum {
+    SHOP_SRC_DEFAULT, // 'shop_default'
+    SHOP_SRC_FILE,    // 'shop_load_file'
+    SHOP_SRC_ENV,     // 'shop_env'
+    SHOP_SRC_ARGV,    // 'shop_track'
+    SHOP_SRC_COUNT,
+} shop_src_t;
+
+// converter of a value type, returns false on invalid value
+typedef bool (*shop_parse_fn)(const char *value, void *dst);
+
 typedef struct {
     unsigned char name;
     const char *info;
     const char *scan_fmt; // used by sscanf
+    shop_type_t type;     // resolved from 'scan_fmt'
     bool used;
     bool take_arg;
     const char **items; // option value array
     size_t len;
     size_t cap;
+    bool borrowed;      // 'items' is the array of a source, see 'shop_flatten'
+    void *bind; // written by 'shop_track', see 'shop_bind'
+    unsigned char *data; // converted values of a registered type
+    size_t data_cap;
+    struct shop__choices *choices; // see 'shop_choices'
+    struct shop__ranges *ranges;   // parsed values of "%range"
+    struct shop__dict *dict;       // index of "%dict" and "%subopt"
+    const char *def;  // default value, see 'shop_default'
+    bool is_default;  // the values are the default one
+    shop_mode_t mode; // see 'shop_mode'
+    size_t count;     // number of occurrences
+    shop_src_t src;   // the source of the values, see 'shop_flatten'
+    struct shop__layers *layers; // raw values of each source
 } shop_option_t;
 
+// an occurrence in argv, see 'shop_events'
+typedef struct {
+    unsigned char name; // option name
+    uint32_t value;     // index of the value, SHOP_NOVALUE if none is kept
+    uint32_t arg;       // index in argv of the option
+} shop_event_t;
+
+#define SHOP_NOVALUE UINT32_MAX
+
+typedef struct {
+    unsigned char map[256]; // option name -> index + 1
+    struct {
+        shop_option_t *items;
+        size_t len;
+        size_t cap;
+    } options;
+    bool defs_loaded; // options of 'SHOP_DEFINE' are registered
+    struct shop__env *env; // see 'shop_env'
+    struct shop__files *files; // buffers of 'shop_load_file'
+    struct shop__subcmds *subcmds; // see 'shop_subcmd'
+    struct {
+        shop_event_t *items;
+        size_t len;
+        size_t cap;
+        bool on;
+    } events; // see 'shop_events'
+    struct {
+        bool on;
+        bool pending; // argv is not fully scanned yet
+        int argc;
+        char **argv;
+        int next;     // the next argument to scan
+    } lazy; // see 'shop_lazy'
+    int threads; // see 'shop_threads'
+} shop_ctx_t;
+
+// option descriptor placed by 'SHOP_DEFINE'
+typedef struct {
+    unsigned char name;
+    bool take_arg;
+    const char *scan_fmt;
+    const char *info;
+    void *bind;
+} shop_def_t;
+
 #define SHOP_ASSERT(expr, fmt, ...)                         \
     do {                                                    \
         if (expr) break;                                    \
@@ -95,6 +224,44 @@ typedef struct {
         exit(EXIT_FAILURE);                                 \
     } while (0)
 
+#if defined(__GNUC__) && defined(__ELF__)
+#define SHOP_HAS_DEFINE
+
+#define SHOP__CAT_(a, b) a##b
+#define SHOP__CAT(a, b) SHOP__CAT_(a, b)
+
+// SHOP_DEFINE - define an option in any source file
+// @name: option name
+// @take_arg: whether the option takes an argument
+// @scan_fmt, @info: see 'shop_desc'
+// @bind: see 'shop_bind', NULL for none
+// Note: the descriptor is a constant in the 'shop_opts' section, the
+//       first call that touches the default context, like 'shop_set',
+//       'shop_desc' or 'shop_track', registers all of them, sorted by
+//       name. no constructor or registration call runs.
+//       only for GCC/Clang on ELF targets.
+//       example: SHOP_DEFINE('j', true, "%d", "Number of jobs", &jobs);
+#define SHOP_DEFINE(name, take_arg, scan_fmt, info, bind)                          \
+    static const shop_def_t SHOP__CAT(shop__def_, __COUNTER__)                       \
+    __attribute__((used, section("shop_opts"), aligned(__alignof__(shop_def_t)))) = \
+    { (name), (take_arg), (scan_fmt), (info), (bind) }
+#endif
+
+// define SHOP_WATCH before including to get 'shop_watch', it needs pthreads
+#if defined(SHOP_WATCH) && defined(__linux__) && defined(__GNUC__)
+#define SHOP_HAS_WATCH
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// shop_switch - switch the current context
+// @ctx: the context to use, NULL for the default one
+// Note: the current context is per thread
+// Return: the previous context
+SHOPDEF shop_ctx_t *shop_switch(shop_ctx_t *ctx);
+
 // shop_set - set the predifined options
 // @opt_str: predifined option string
 // Note: 'n:' means option 'n' with argument
@@ -107,14 +274,202 @@ SHOPDEF void shop_set(const char *opt_str);
 // @info: help message
 SHOPDEF void shop_desc(unsigned char name, const char *scan_fmt, const char *info);
 
+// shop_bind - bind the option to a variable
+// @dst: the pointer to destination, like the one of 'shop_sget'
+// @scan_fmt: scan format string, NULL to keep the one of 'shop_desc',
+//            an option with argument needs one of the two
+// Note: 'shop_track' converts the value into 'dst' on each occurrence,
+//       so the last one wins. an option without argument writes 'true'
+//       into a bool. the program then reads 'dst' with no library call.
+//       an invalid value is an error. a "%dict" or "%subopt" option can
+//       not be bound, read it with 'shop_dict_get'.
+SHOPDEF void shop_bind(unsigned char name, void *dst, const char *scan_fmt);
+
+// shop_register_type - register a value type for 'shop_desc'
+// @scan_fmt: format of the type, like "%ip"
+// @parse: converter of the type
+// @size: size of a converted value
+// Note: register before 'shop_desc'. the values of such an option are
+//       converted once by 'shop_track' into a typed cache, an invalid
+//       value is an error. 'shop_sget', 'shop_iter' and 'shop_export'
+//       read the cache.
+// Return: the type id
+SHOPDEF shop_type_t shop_register_type(const char *scan_fmt, shop_parse_fn parse, size_t size);
+
+// shop_choices - restrict the option value to a set of choices
+// @name: option name
+// @choices: the accepted values
+// @n: number of choices
+// Note: call after 'shop_desc'. a perfect hash of the choices is built
+//       once, 'shop_track' turns each value into its index in 'choices'
+//       (an int, read by 'shop_sget') and reports an invalid one.
+//       example: shop_choices('b', (const char*[]){"lz4", "zstd", "none"}, 3);
+SHOPDEF void shop_choices(unsigned char name, const char *const *choices, size_t n);
+
+// shop_mode - set how the occurrences of an option are kept
+// @name: option name
+// @mode: see 'shop_mode_t'
+// Note: SHOP_LAST, SHOP_FIRST and SHOP_COUNT take O(1) memory however
+//       often the option is given. a variable bound to a SHOP_COUNT
+//       option is an int that gets the count.
+SHOPDEF void shop_mode(unsigned char name, shop_mode_t mode);
+
+// shop_count - get the number of occurrences of an option, like 3 of '-vvv'
+// @name: option name
+SHOPDEF size_t shop_count(unsigned char name);
+
+// shop_default - set the default value of an option with argument
+// @name: option name
+// @value: the default value
+// Note: call after 'shop_desc', 'shop_choices' and 'shop_bind'. the value
+//       is converted here, once, into the same slot as a given value, so
+//       reading an unset option costs the same. any other source drops
+//       it, see 'shop_flatten'. 'shop_use' still reports the option
+//       unused. an invalid default is an error.
+SHOPDEF void shop_default(unsigned char name, const char *value);
+
+// shop_env - let an option fall back to an environment variable
+// @name: option name
+// @var: the variable name, like "MYAPP_THREADS"
+// Note: 'shop_track' scans 'environ' once after argv, matching each
+//       entry against a hash of the configured names, and records the
+//       values (not copied) as the SHOP_SRC_ENV source. they are used
+//       only if argv does not give the option. a flag is set by a true
+//       "%b" value.
+SHOPDEF void shop_env(unsigned char name, const char *var);
+
+// shop_env_prefix - let all options fall back to '<prefix><name>'
+// @prefix: like "MYAPP_" for 'MYAPP_n' of option 'n', NULL to disable
+// Note: same as 'shop_env', checked in the same scan without a hash
+SHOPDEF void shop_env_prefix(const char *prefix);
+
+// shop_load_file - load option values from an INI-style file
+// @path: file path
+// @section: the section to read, NULL for the keys before any section
+// Note: the values are the SHOP_SRC_FILE source, used only if neither
+//       argv nor the environment gives the option, so it may be called
+//       before or after 'shop_track'. the file is mapped privately and
+//       only the lines of 'section' are tokenized, other sections are
+//       skipped line by line. a key is an option name, like 'n = 42',
+//       keys of no option are ignored, and a key may repeat. values
+//       point into the mapping, which lives until 'shop_free'. lines
+//       starting with ';' or '#' are comments.
+// Return: false if the file can not be read
+SHOPDEF bool shop_load_file(const char *path, const char *section);
+
+// shop_subcmd - declare a subcommand, like 'build' of 'tool build -j4'
+// @name: subcommand name
+// @setup: declares its options, like 'shop_set', 'shop_desc', ..., or NULL
+// @info: description, listed by 'shop_help'
+// Note: nothing of the subcommand is built here. in 'shop_track' the
+//       first non-option argument is looked up in a hash of the names,
+//       and only the selected subcommand gets a child context: 'setup'
+//       runs in it, then 'shop_track' on the rest of argv, the name
+//       being its argv[0]. an unknown subcommand is an error. a
+//       subcommand may declare its own subcommands.
+SHOPDEF void shop_subcmd(const char *name, void (*setup)(void), const char *info);
+
+// shop_selected - get the subcommand selected by 'shop_track'
+// @ctx: set to its context, read it after 'shop_switch', may be NULL
+// Return: the subcommand name, NULL if none is selected
+SHOPDEF const char *shop_selected(shop_ctx_t **ctx);
+
+#ifdef SHOP_HAS_WATCH
+// shop_watch - rebuild the options in the background when a file changes
+// @path, @section: see 'shop_load_file'
+// @setup: declares the options, like 'shop_set', 'shop_desc', ...
+// @argc, @argv: see 'shop_track', kept until 'shop_unwatch'
+// Note: each build runs in a fresh context: 'setup', the file, then
+//       'shop_track', and is published with one atomic pointer swap.
+//       the first build runs here. the directory of 'path' is watched
+//       with inotify, so an editor replacing the file is seen too. a
+//       build that fails, on a file that can not be read or on any
+//       error that 'shop_track' would exit on, is dropped and reported
+//       on stderr, the old snapshot stays. 'setup' runs on the watcher
+//       thread, register types before. one file at a time. linux
+//       only, define SHOP_WATCH before including shop.h.
+// Return: false if the first build fails, or a file is watched
+SHOPDEF bool shop_watch(const char *path, const char *section, void (*setup)(void), int argc, char **argv);
+
+// shop_acquire - pin the latest snapshot of 'shop_watch' in this thread
+// Note: it is the current context until 'shop_release', read it with
+//       the getters. no lock is taken, and a reload does not wait for
+//       the readers, it frees the old snapshot once nobody pins it.
+//       pins do not nest.
+// Return: the previous context, for 'shop_release'
+SHOPDEF shop_ctx_t *shop_acquire(void);
+
+// shop_release - unpin the snapshot of 'shop_acquire'
+// @prev: the return value of 'shop_acquire'
+SHOPDEF void shop_release(shop_ctx_t *prev);
+
+// shop_unwatch - stop 'shop_watch' and free its snapshot
+// Note: no thread may pin it anymore
+SHOPDEF void shop_unwatch(void);
+#endif
+
+// shop_flatten - resolve the sources of every option into its values
+// Note: the values of the highest source given win, see 'shop_src_t'.
+//       a SHOP_MERGE option merges the values of all given sources
+//       instead, in that order. it runs once per change of the sources,
+//       'shop_track' calls it at its end, and reads never look at more
+//       than the result.
+SHOPDEF void shop_flatten(void);
+
 // shop_track - track the cmdline arguments and update option's state
 // @argc: number of argument
 // @argv: argument string array
-// Note: supports option combination (e.g., -abc).
+// Note: scans the environment after argv, see 'shop_env',
+//       and ends with 'shop_flatten'. see 'shop_lazy' to defer it.
+//       with subcommands, the first non-option argument selects one
+//       and ends the options of this context, see 'shop_subcmd'.
+//       supports option combination (e.g., -abc).
 //       in combined options, only the **last one** may take an argument.
 //       example: '-fdata.txt' or '-f data.txt' where 'f' requires an argument.
 SHOPDEF void shop_track(int argc, char **argv);
 
+// shop_events - log the occurrences of argv in order
+// @on: whether 'shop_track' logs them
+// Note: one entry per occurrence, written in the same pass, so the
+//       order between options, like '-i a -o x -i b', is kept. the
+//       value index is the one of 'shop_sget', SHOP_NOVALUE for a flag
+//       or a value dropped by SHOP_LAST/SHOP_FIRST/SHOP_COUNT (for
+//       "%range" it is the index of the raw value). a subcommand
+//       inherits it, with its own log.
+SHOPDEF void shop_events(bool on);
+
+// shop_event_log - get the log of the last 'shop_track'
+// @len: set to the number of events
+// Return: the events, in argv order
+SHOPDEF const shop_event_t *shop_event_log(size_t *len);
+
+// shop_lazy - defer the scan of argv to the first query
+// @on: whether 'shop_track' only records argc and argv
+// Note: argv must outlive the queries. 'shop_use' of a flag, or of a
+//       SHOP_FIRST option, scans only until its first occurrence, any
+//       other query scans the rest of argv once, then the environment
+//       and 'shop_flatten' follow as in 'shop_track'. so the cost grows
+//       with the options read, not with argv. an error of argv shows up
+//       at that scan. the argv source is replaced, not added to. a
+//       context with a bound option, see 'shop_bind', is scanned in
+//       'shop_track' as without it, the variables are written there.
+SHOPDEF void shop_lazy(bool on);
+
+// shop_threads - scan a large argv on several threads in 'shop_track'
+// @n: number of threads, 1 or less to scan on the calling thread
+// Note: argv is split into chunks on argument boundaries, each thread
+//       collects the occurrences of its chunk, then the values of each
+//       option are placed in argv order by a prefix sum over the
+//       chunks. the result, errors included, is the one of a single
+//       thread. chunks are at least 'SHOP_CHUNK' arguments, and a
+//       context with subcommands or 'shop_lazy' is scanned on one.
+//       unix only, ignored elsewhere.
+SHOPDEF void shop_threads(int n);
+
+#ifndef SHOP_CHUNK
+#define SHOP_CHUNK 65536
+#endif
+
 // shop_free - free the memory
 SHOPDEF void shop_free(void);
 
@@ -127,169 +482,2618 @@ SHOPDEF const shop_option_t *shop_use(unsigned char name);
 // @name: option name
 // @idx: index of option value array
 // @dst: the pointer to destination
-// Note: support an extra format "%b" for boolean type
-//       steal from https://github.com/rxi/ini/blob/master/src/ini.c
+// Note: support extra formats "%b" for boolean type, and "%size",
+//       "%dur" and "%rate" for units (see 'shop_type_t'). the unit
+//       types are converted once by 'shop_track', with overflow check.
+//       "%s" and "%b" use the converters of 'shop_get_xxx', resolved
+//       once in 'shop_desc', other formats go through 'sscanf', so
+//       '42abc' reads 42 with "%d".
 // Return: true if get the value, false otherwise
 SHOPDEF bool shop_sget(unsigned char name, size_t idx, void *dst);
 
+// shop_get_xxx - get the option value converted to the destination type
+// @name: option name
+// @idx: index of option value array
+// @dst: the pointer to destination
+// Note: the value must be fully consumed, '42abc' is not an int.
+//       the scan format of the option is not consulted.
+// Return: true if get the value, false otherwise
+SHOPDEF bool shop_get_str(unsigned char name, size_t idx, const char **dst);
+SHOPDEF bool shop_get_bool(unsigned char name, size_t idx, bool *dst);
+SHOPDEF bool shop_get_int(unsigned char name, size_t idx, int *dst);
+SHOPDEF bool shop_get_long(unsigned char name, size_t idx, long *dst);
+SHOPDEF bool shop_get_float(unsigned char name, size_t idx, float *dst);
+SHOPDEF bool shop_get_double(unsigned char name, size_t idx, double *dst);
+
+// shop_get - get the option value, the converter is picked by the type of 'dst'
+// Note: needs C11, 'shop_sget' or 'shop_get_xxx' in C99.
+//       an unsupported destination type is a compile error.
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && !defined(__cplusplus)
+#define shop_get(name, idx, dst)       \
+    _Generic((dst),                    \
+        const char **: shop_get_str,   \
+        bool *:        shop_get_bool,  \
+        int *:         shop_get_int,   \
+        long *:        shop_get_long,  \
+        float *:       shop_get_float, \
+        double *:      shop_get_double \
+    )(name, idx, dst)
+#endif
+
 // shop_len - get the length of option value array
 // @name: option name
+// Note: for "%range" it is the number of integers in all ranges, they
+//       are generated on access and never stored one by one
 SHOPDEF size_t shop_len(unsigned char name);
 
+// shop_get_bitmap - set the integers of a "%range" option in a bitset
+// @name: option name
+// @bits: bitset of 'nbits' bits, like the one of 'cpu_set_t'
+// @nbits: number of bits
+// Note: 'bits' is cleared first, whole words are filled at once
+// Return: false if not a "%range" option or a value is out of 'nbits'
+SHOPDEF bool shop_get_bitmap(unsigned char name, uint64_t *bits, size_t nbits);
+
+// iterator over the option values, see 'shop_iter'
+typedef struct {
+    const shop_option_t *opt;
+    shop_type_t type;
+    size_t idx;
+    size_t len;
+} shop_iter_t;
+
+// shop_dict_get - look up a key of a "%dict" or "%subopt" option
+// @name: option name
+// @key: the key
+// @len: length of the value, can be NULL
+// Note: keys and values are not copied, the value points into argv and
+//       is not NUL-terminated for "%subopt" ('1' of '-o a=1,b=2'), so
+//       use 'len'. a key without '=' has an empty value. the last
+//       occurrence of a key wins. one hash lookup.
+// Return: the value, NULL if the key is not given
+SHOPDEF const char *shop_dict_get(unsigned char name, const char *key, size_t *len);
+
+// shop_iter - resolve the option once to iterate its values
+// @name: option name
+// @type: destination type, SHOP_NONE to follow the scan format like 'shop_sget'
+// Return: the iterator, empty if the option has no value
+SHOPDEF shop_iter_t shop_iter(unsigned char name, shop_type_t type);
+
+// shop_next - convert the current value and advance
+// @it: iterator from 'shop_iter'
+// @dst: the pointer to destination
+// Return: true if get the value, false at the end or on invalid value
+SHOPDEF bool shop_next(shop_iter_t *it, void *dst);
+
+// shop_export - convert the option values into an array in one call
+// @name: option name
+// @type: element type, from SHOP_STR to SHOP_DOUBLE or a registered one
+// @out: destination array, like 'int[n]' for SHOP_INT
+// @n: capacity of 'out'
+// Return: number of values written, it stops at the first invalid value
+SHOPDEF size_t shop_export(unsigned char name, shop_type_t type, void *out, size_t n);
+
+// a task of an executor, see 'shop_convert_all_with'
+typedef void (*shop_task_fn)(void *arg, size_t i);
+
+// an executor runs 'task(arg, i)' for every i < n, in any order and on
+// any thread, and returns once all of them are done
+typedef void (*shop_exec_fn)(void *user, shop_task_fn task, void *arg, size_t n);
+
+// shop_convert_all - 'shop_export' on several threads, checking every value
+// @name, @type, @out, @n: see 'shop_export'
+// @ok: set per value to whether it is valid, may be NULL
+// @nthreads: number of threads, each converts a contiguous part
+// Note: an invalid value does not stop the others, 'out' is left as is
+//       at its index. the threads come from an internal pool, started
+//       by the first call and kept for the next ones, also used by
+//       'shop_threads'. a call while the pool is busy runs alone.
+// Return: number of invalid values, SIZE_MAX if the option is unknown,
+//         takes no argument, or can not be read as 'type'
+SHOPDEF size_t shop_convert_all(unsigned char name, shop_type_t type, void *out, size_t n, bool *ok, int nthreads);
+
+// shop_convert_all_with - same as 'shop_convert_all', on a caller executor
+// @exec, @user: the executor, like a thread pool of the program, it gets
+//               a task per 'SHOP_CHUNK' values
+SHOPDEF size_t shop_convert_all_with(unsigned char name, shop_type_t type, void *out, size_t n, bool *ok,
+                                     shop_exec_fn exec, void *user);
+
 // shop_foreach - iterate the option values
 // @name: option name
 // @idx: index name
 // @dst: pointer to destination
-#define shop_foreach(name, idx, dst) for (size_t idx = 0; shop_sget(name, idx, dst); idx++)
+// Note: the option is resolved once, see 'shop_iter'
+#define shop_foreach(name, idx, dst)                                        \
+    for (size_t idx = 0, shop__once = 1; shop__once; shop__once = 0)        \
+        for (shop_iter_t shop__it = shop_iter(name, SHOP_NONE);             \
+             shop_next(&shop__it, dst); idx++)
+
+// parsed state written by 'shop_serialize', see 'shop_attach'
+typedef struct shop_blob shop_blob_t;
+
+// shop_serialize - write the parsed state into a position-independent blob
+// @buf: destination, 8-byte aligned, may be NULL to get the size
+// @size: capacity of 'buf'
+// Note: strings are offsets into the blob, and the values converted by
+//       'shop_track' are kept as typed slots. "%range" and "%dict"
+//       options keep their raw values. the blob is versioned and meant
+//       for a child of the same binary, like one exec'd by it.
+// Return: the size of the blob, nothing is written if it exceeds 'size'
+SHOPDEF size_t shop_serialize(void *buf, size_t size);
+
+// shop_serialize_fd - write the blob of 'shop_serialize' into a file
+// @fd: like a 'memfd_create' one, inherited by the child
+// Return: false if it can not be written
+SHOPDEF bool shop_serialize_fd(int fd);
+
+// shop_attach - read a blob of 'shop_serialize' in place
+// @blob: the blob, 8-byte aligned
+// @size: its size
+// Note: only the header and the option table are checked, nothing is
+//       parsed or allocated. the blob must outlive its readers.
+// Return: the blob, NULL if it is not a valid one of this version
+SHOPDEF const shop_blob_t *shop_attach(const void *blob, size_t size);
+
+// shop_attach_fd - map a blob of 'shop_serialize_fd' read-only
+// @fd: the file, read from its start
+// Note: only the blob is mapped, bytes after it in the file are not
+// Return: the blob, NULL if it can not be mapped or is not valid
+SHOPDEF const shop_blob_t *shop_attach_fd(int fd);
+
+// shop_detach - unmap a blob of 'shop_attach_fd'
+// Note: the mapping is the size in its header, the blob must not change
+SHOPDEF void shop_detach(const shop_blob_t *blob);
+
+// shop_blob_xxx - read an option of a blob, like 'shop_use', 'shop_len' and 'shop_get_xxx'
+// @type: SHOP_STR points into the blob, the type of a typed slot is a
+//        copy, others are converted from the string
+SHOPDEF bool shop_blob_use(const shop_blob_t *blob, unsigned char name);
+SHOPDEF size_t shop_blob_len(const shop_blob_t *blob, unsigned char name);
+SHOPDEF bool shop_blob_get(const shop_blob_t *blob, unsigned char name, size_t idx, shop_type_t type, void *dst);
+
+// an option value replaced by 'shop_build_argv'
+typedef struct {
+    unsigned char name; // 0 ends the list
+    const char *value;  // NULL drops the option, any other sets a flag
+} shop_override_t;
+
+// shop_build_argv - build the canonical argv of the parsed options
+// @ctx: the context, NULL for the current one
+// @prog: argv[0]
+// @overrides: replace the values of their options, may be NULL
+// @argv_out: set to the NULL-terminated argv, release it with 'free'
+// Note: the used options come in the order of 'shop_set', one argument
+//       per value like '-n42' (an empty value is split, '-n' ""), a
+//       flag is repeated for SHOP_COUNT, then the selected subcommand
+//       and its own options. defaults are left out. the pointers and
+//       the strings are in a single allocation, ready for 'execv' or
+//       'posix_spawn'.
+// Return: argc
+SHOPDEF size_t shop_build_argv(shop_ctx_t *ctx, const char *prog, const shop_override_t *overrides, char ***argv_out);
+
+// shop_build_argv_buf - same as 'shop_build_argv', into a caller buffer
+// @buf: destination, aligned for pointers
+// @size: capacity of 'buf'
+// @argv_out: set to the argv in 'buf', NULL if it does not fit
+// Return: the size needed
+SHOPDEF size_t shop_build_argv_buf(shop_ctx_t *ctx, const char *prog, const shop_override_t *overrides,
+                                   void *buf, size_t size, char ***argv_out);
+
+// 128-bit fingerprint, see 'shop_fingerprint'
+typedef struct {
+    uint64_t lo;
+    uint64_t hi;
+} shop_fingerprint_t;
+
+// shop_fingerprint - hash the effective options of the current context
+// Note: the same configuration gets the same fingerprint however it is
+//       spelled, '-vn42' or '-v -n 042', in any option order, given or
+//       as default. options are hashed by name with their converted
+//       values, in the order of the values of each option. a flag
+//       counts only for SHOP_COUNT. adjacent "%range"s are merged, a
+//       "%dict" or "%subopt" counts its distinct keys with the value
+//       'shop_dict_get' returns, in key order, and the selected
+//       subcommand is included. other types hash their raw value.
+//       stable for the same build, not across machines.
+SHOPDEF shop_fingerprint_t shop_fingerprint(void);
 
 // shop_verbose - print all options' state as a table
 SHOPDEF void shop_verbose(void);
 
 // shop_help - print the help message
-// Note: '*' before the option means it require a parameter
+// Note: '*' before the option means it require a parameter,
+//       the default value is shown after the message
 SHOPDEF void shop_help(void);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif // SHOP_H
 
 #ifdef SHOP_IMPLEMENTATION
 
-static unsigned char shop__map[255] = {0};
-static struct {
-    shop_option_t *items;
+#if defined(__unix__) || defined(__APPLE__)
+#define SHOP__HAS_MMAP
+#define SHOP__HAS_THREADS
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <pthread.h>
+#endif
+
+#ifdef SHOP_HAS_WATCH
+#include <poll.h>
+#include <setjmp.h>
+#include <sys/inotify.h>
+#endif
+
+#if defined(__cplusplus)
+#define SHOP__TLS thread_local
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#define SHOP__TLS _Thread_local
+#elif defined(__GNUC__)
+#define SHOP__TLS __thread
+#else
+#define SHOP__TLS
+#endif
+
+static shop_ctx_t shop__default_ctx;
+static SHOP__TLS shop_ctx_t *shop__ctx = &shop__default_ctx;
+
+#ifdef SHOP_HAS_WATCH
+// set while 'shop_watch' builds a snapshot, an error gives up the build
+// instead of exiting
+static SHOP__TLS jmp_buf *shop__recover;
+
+__attribute__((noreturn)) static void shop__fail(void) {
+    if (shop__recover) longjmp(*shop__recover, 1);
+    exit(EXIT_FAILURE);
+}
+
+#undef SHOP_ASSERT
+#define SHOP_ASSERT(expr, fmt, ...)                         \
+    do {                                                    \
+        if (expr) break;                                    \
+        fprintf(stderr, "ERROR: " fmt "\n", ##__VA_ARGS__); \
+        shop__fail();                                       \
+    } while (0)
+#endif
+
+// the cast through 'void **' keeps it valid C++
+#define shop__push(vec, item)                                                                \
+    do {                                                                                     \
+        if ((vec)->len + 1 > (vec)->cap) {                                                   \
+            (vec)->cap = (vec)->cap < 8 ? 8 : 2*(vec)->cap;                                  \
+            *(void **) &(vec)->items = realloc((vec)->items, (vec)->cap*sizeof(*(vec)->items)); \
+            SHOP_ASSERT((vec)->items, "out of memory");                                      \
+        }                                                                                    \
+        (vec)->items[(vec)->len++] = (item);                                                 \
+    } while (0)
+
+typedef struct {
+    long lo, hi;
+    size_t before; // number of integers in the previous ranges
+} shop__range_t;
+
+struct shop__ranges {
+    shop__range_t *items;
     size_t len;
     size_t cap;
-} shop__options = {0};
-
-#define shop__push(vec, item)                                                       \
-    do {                                                                            \
-        if ((vec)->len + 1 > (vec)->cap) {                                          \
-            (vec)->cap = (vec)->cap < 8 ? 8 : 2*(vec)->cap;                         \
-            (vec)->items = realloc((vec)->items, (vec)->cap*sizeof(*(vec)->items)); \
-            SHOP_ASSERT((vec)->items, "out of memory");                             \
-        }                                                                           \
-        (vec)->items[(vec)->len++] = (item);                                        \
-    } while (0)
+    size_t total;
+};
+
+// open addressing over the string keys of a vector, the items start
+// with the key and its length, like 'shop__pair_t'
+struct shop__index {
+    uint32_t *slots; // slot -> item index + 1, 0 if empty
+    size_t mask;
+    size_t keys;     // number of distinct keys
+};
+
+typedef struct {
+    const char *key; // points into argv
+    size_t klen;
+    const char *val;
+    size_t vlen;
+} shop__pair_t;
+
+struct shop__dict {
+    shop__pair_t *items;
+    size_t len;
+    size_t cap;
+    struct shop__index index;
+};
+
+typedef struct {
+    const char *var;
+    size_t len;
+    unsigned char name;
+} shop__envvar_t;
+
+struct shop__env {
+    shop__envvar_t *items;
+    size_t len;
+    size_t cap;
+    struct shop__index index;
+    const char *prefix;
+};
+
+typedef struct {
+    char *addr;
+    size_t len;
+    bool mapped; // 'munmap' it, otherwise 'free'
+} shop__file_t;
+
+struct shop__files {
+    shop__file_t *items;
+    size_t len;
+    size_t cap;
+};
+
+typedef struct {
+    const char **items; // raw values
+    size_t len;
+    size_t cap;
+    size_t count;       // occurrences
+} shop__layer_t;
+
+struct shop__layers {
+    shop__layer_t src[SHOP_SRC_COUNT];
+};
+
+typedef struct {
+    const char *name;
+    size_t len;
+    void (*setup)(void);
+    const char *info;
+} shop__subcmd_t;
+
+struct shop__subcmds {
+    shop__subcmd_t *items;
+    size_t len;
+    size_t cap;
+    struct shop__index index;
+    const char *selected; // name of the selected one
+    shop_ctx_t *child;    // its context
+};
+
+static void shop__drop(shop_ctx_t *ctx);
+static void shop__lazy_resolve(unsigned char name);
+static void shop__load_defs(void);
+
+SHOPDEF shop_ctx_t *shop_switch(shop_ctx_t *ctx) {
+    shop_ctx_t *prev = shop__ctx;
+    shop__ctx = ctx ? ctx : &shop__default_ctx;
+    return prev;
+}
 
 SHOPDEF void shop_set(const char *opt_str) {
+    shop__load_defs();
     size_t len = strlen(opt_str);
-    char input[len+1];
 
-    memcpy(input, opt_str, len);
-    input[len] = '\0';
+    // ':' and ' ' split the tokens, the last option of a token takes argument
+    for (size_t i = 0; i < len; i++) {
+        char c = opt_str[i];
+        if (c == ':' || c == ' ') continue;
 
-    char *p = input;
-    const char *token;
-    while ((token = strtok(p, ": "))) {
-        // printf("token: '%s'\n", token);
-        for (size_t i = 0; i < strlen(token); i++) {
-            shop_option_t opt = { .name = token[i], .take_arg = false };
-            if (i == strlen(token) - 1) opt.take_arg = true;
-            shop__push(&shop__options, opt);
-            shop__map[opt.name] = (unsigned char) shop__options.len;
-        }
-        p = NULL;
+        shop_option_t opt;
+        memset(&opt, 0, sizeof(opt));
+        opt.name = (unsigned char) c;
+        SHOP_ASSERT(shop__ctx->map[opt.name] == 0, "option '-%c' defined twice", c);
+        opt.take_arg = (i + 1 == len || opt_str[i+1] == ':' || opt_str[i+1] == ' ');
+        shop__push(&shop__ctx->options, opt);
+        shop__ctx->map[opt.name] = (unsigned char) shop__ctx->options.len;
     }
 
     // check if the last option requires argument
-    if (opt_str[len-1] != ':') {
-        shop_option_t *last_option = &shop__options.items[shop__options.len-1];
+    if (len > 0 && opt_str[len-1] != ':') {
+        shop_option_t *last_option = &shop__ctx->options.items[shop__ctx->options.len-1];
         last_option->take_arg = false;
     }
 }
 
 SHOPDEF void shop_free(void) {
-    for (size_t i = 0; i < shop__options.len; i++) {
-        const shop_option_t *opt_ptr = &shop__options.items[i];
-        if (opt_ptr->items) free(opt_ptr->items);
+    for (size_t i = 0; i < shop__ctx->options.len; i++) {
+        const shop_option_t *opt_ptr = &shop__ctx->options.items[i];
+        if (opt_ptr->items && !opt_ptr->borrowed) free((void *) opt_ptr->items);
+        if (opt_ptr->data) free(opt_ptr->data);
+        if (opt_ptr->choices) free(opt_ptr->choices);
+        if (opt_ptr->ranges) {
+            free(opt_ptr->ranges->items);
+            free(opt_ptr->ranges);
+        }
+        if (opt_ptr->dict) {
+            free(opt_ptr->dict->items);
+            free(opt_ptr->dict->index.slots);
+            free(opt_ptr->dict);
+        }
+        if (opt_ptr->layers) {
+            for (int s = 0; s < SHOP_SRC_COUNT; s++) free((void *) opt_ptr->layers->src[s].items);
+            free(opt_ptr->layers);
+        }
+    }
+    if (shop__ctx->options.items) free(shop__ctx->options.items);
+    if (shop__ctx->env) {
+        free(shop__ctx->env->items);
+        free(shop__ctx->env->index.slots);
+        free(shop__ctx->env);
+    }
+    if (shop__ctx->files) {
+        for (size_t i = 0; i < shop__ctx->files->len; i++) {
+            shop__file_t *f = &shop__ctx->files->items[i];
+#ifdef SHOP__HAS_MMAP
+            if (f->mapped) {
+                munmap(f->addr, f->len);
+                continue;
+            }
+#endif
+            free(f->addr);
+        }
+        free(shop__ctx->files->items);
+        free(shop__ctx->files);
     }
-    if (shop__options.items) free(shop__options.items);
-    memset(&shop__options, 0, sizeof(shop__options));
-    memset(&shop__map, 0, sizeof(shop__map));
+    if (shop__ctx->subcmds) {
+        if (shop__ctx->subcmds->child) shop__drop(shop__ctx->subcmds->child);
+        free(shop__ctx->subcmds->items);
+        free(shop__ctx->subcmds->index.slots);
+        free(shop__ctx->subcmds);
+    }
+    free(shop__ctx->events.items);
+    memset(shop__ctx, 0, sizeof(*shop__ctx));
+}
+
+// shop__drop - free a context allocated by the library
+static void shop__drop(shop_ctx_t *ctx) {
+    shop_ctx_t *prev = shop_switch(ctx);
+    shop_free();
+    shop_switch(prev);
+    free(ctx);
+}
+
+// shop__lazy_finish - scan the rest of a lazy argv, see 'shop_lazy'
+static void shop__lazy_finish(void) {
+    if (shop__ctx->lazy.pending) shop__lazy_resolve(0);
 }
 
 static shop_option_t *shop__find(unsigned char name) {
-    unsigned char idx = shop__map[(unsigned int) name];
+    shop__load_defs();
+    unsigned char idx = shop__ctx->map[name];
     if (idx == 0) return NULL;
-    return &shop__options.items[idx - 1];
+    return &shop__ctx->options.items[idx - 1];
 }
 
-SHOPDEF void shop_desc(unsigned char name, const char *scan_fmt, const char *info) {
-    shop_option_t *opt_ptr = shop__find(name);
-    opt_ptr->scan_fmt = scan_fmt;
-    opt_ptr->info = info;
+// shop__query - find an option to read, scanning the rest of a lazy argv first
+static const shop_option_t *shop__query(unsigned char name) {
+    shop__lazy_finish();
+    return shop__find(name);
 }
 
-SHOPDEF const shop_option_t *shop_use(unsigned char name) {
-    const shop_option_t *opt_ptr = shop__find(name);
-    if (opt_ptr && opt_ptr->used) return opt_ptr;
-    return NULL;
+static bool shop__conv_str(const char *value, void *dst) {
+    *((const char**) dst) = value;
+    return true;
 }
 
-SHOPDEF void shop_track(int argc, char **argv) {
-    for (int i = 1; i < argc; i++) {
-        const char *arg = argv[i];
+// steal from https://github.com/rxi/ini/blob/master/src/ini.c
+static bool shop__conv_bool(const char *value, void *dst) {
+    bool res = (strcmp(value, "true") == 0 ||
+                strcmp(value, "yes") == 0 ||
+                strcmp(value, "1") == 0 ||
+                strcmp(value, "on") == 0);
+    memcpy(dst, &res, sizeof(bool));
+    return true;
+}
 
-        // skip non-option arg
-        if (arg[0] != '-') continue;
+static bool shop__conv_long(const char *value, void *dst) {
+    char *end;
+    errno = 0;
+    long res = strtol(value, &end, 10);
+    if (end == value || *end != '\0' || errno == ERANGE) return false;
+    *((long*) dst) = res;
+    return true;
+}
 
-        // handle current option (may combined, -rhp)
-        bool has_param_in_next_arg = false;
-        for (int j = 1; arg[j] != '\0'; j++) {
-            char name = arg[j];
-            shop_option_t *opt = shop__find(name);
-            SHOP_ASSERT(opt, "unknown option: '-%c'", name);
-            opt->used = true;
+static bool shop__conv_int(const char *value, void *dst) {
+    long res;
+    if (!shop__conv_long(value, &res) || res < INT_MIN || res > INT_MAX) return false;
+    *((int*) dst) = (int) res;
+    return true;
+}
 
-            // check if the option param is in next cmdline arg
-            // -f data.txt or -fdata.txt
-            if (opt->take_arg) {
-                if (arg[j+1] != '\0') shop__push(opt, arg + j + 1);
-                else has_param_in_next_arg = true;
-                break;
-            }
+static bool shop__conv_double(const char *value, void *dst) {
+    char *end;
+    errno = 0;
+    double res = strtod(value, &end);
+    if (end == value || *end != '\0' || errno == ERANGE) return false;
+    *((double*) dst) = res;
+    return true;
+}
+
+static bool shop__conv_float(const char *value, void *dst) {
+    char *end;
+    errno = 0;
+    float res = strtof(value, &end);
+    if (end == value || *end != '\0' || errno == ERANGE) return false;
+    *((float*) dst) = res;
+    return true;
+}
+
+// shop__fixed - parse a decimal like '12' or '1.5'
+// @ip, @fp: integer part, fraction part
+// @scale: 10^(digits of fraction part), up to 9 digits are kept
+// Return: the end of the decimal, NULL if there is no digit or it overflows
+static const char *shop__fixed(const char *s, uint64_t *ip, uint64_t *fp, uint64_t *scale) {
+    const char *start = s;
+    *ip = 0, *fp = 0, *scale = 1;
+    for (; *s >= '0' && *s <= '9'; s++) {
+        uint64_t d = (uint64_t) (*s - '0');
+        if (*ip > (UINT64_MAX - d)/10) return NULL;
+        *ip = *ip*10 + d;
+    }
+    if (*s == '.') {
+        s++;
+        for (; *s >= '0' && *s <= '9'; s++) {
+            if (*scale >= 1000000000) continue;
+            *fp = *fp*10 + (uint64_t) (*s - '0');
+            *scale *= 10;
         }
+    }
+    if (s == start || (s == start + 1 && *start == '.')) return NULL;
+    return s;
+}
 
-        // handle next option argument if it is
-        if (has_param_in_next_arg) {
-            i++; // skip current option
-            SHOP_ASSERT(i < argc, "option '%s' require argument but not supply", arg);
-            // find the option which need this argument
-            for (int j = 1; arg[j] != '\0'; j++) {
-                shop_option_t *opt = shop__find(arg[j]);
-                if (opt && opt->take_arg) {
-                    shop__push(opt, argv[i]);
-                    break;
-                }
-            }
+// shop__mul - out = (ip + fp/scale) * mult, truncated
+// Return: false if it overflows
+static bool shop__mul(uint64_t ip, uint64_t fp, uint64_t scale, uint64_t mult, uint64_t *out) {
+    if (mult != 0 && ip > UINT64_MAX/mult) return false;
+    uint64_t res = ip*mult;
+    // fp < scale, so neither product overflows
+    uint64_t frac = mult/scale*fp + (mult%scale)*fp/scale;
+    if (res > UINT64_MAX - frac) return false;
+    *out = res + frac;
+    return true;
+}
+
+typedef struct {
+    const char *suffix;
+    uint64_t mult;
+} shop__unit_t;
+
+// shop__unit - match the longest unit at 's'
+// Return: the length of the unit, 0 if none
+static size_t shop__unit(const char *s, const shop__unit_t *units, size_t n, uint64_t *mult) {
+    size_t best = 0;
+    for (size_t i = 0; i < n; i++) {
+        size_t len = strlen(units[i].suffix);
+        if (len > best && strncmp(s, units[i].suffix, len) == 0) {
+            best = len;
+            *mult = units[i].mult;
         }
     }
+    return best;
 }
 
-SHOPDEF void shop_verbose(void) {
-    const int DESC_WIDTH = 20;
-    const int ARG_WIDTH = 10;
+static const shop__unit_t shop__size_units[] = {
+    { "B", 1 },
+    { "K", 1ull<<10 }, { "KB", 1ull<<10 }, { "KiB", 1ull<<10 }, { "k", 1ull<<10 },
+    { "M", 1ull<<20 }, { "MB", 1ull<<20 }, { "MiB", 1ull<<20 },
+    { "G", 1ull<<30 }, { "GB", 1ull<<30 }, { "GiB", 1ull<<30 },
+    { "T", 1ull<<40 }, { "TB", 1ull<<40 }, { "TiB", 1ull<<40 },
+    { "P", 1ull<<50 }, { "PB", 1ull<<50 }, { "PiB", 1ull<<50 },
+    { "E", 1ull<<60 }, { "EB", 1ull<<60 }, { "EiB", 1ull<<60 },
+};
 
-    printf("\n%-6s  %-*s  %-6s  %-10s  %-*s\n",
-           "Option", DESC_WIDTH, "Description", "Used", "Type", ARG_WIDTH, "Argument");
-    printf("%-6s  %-*s  %-6s  %-10s  %-*s\n",
-           "------", DESC_WIDTH, "-----------", "----", "----", ARG_WIDTH, "--------");
+static const shop__unit_t shop__dur_units[] = {
+    { "ns", 1ull },
+    { "us", 1000ull },
+    { "ms", 1000000ull },
+    { "s",  1000000000ull },
+    { "m",  60*1000000000ull },
+    { "h",  3600*1000000000ull },
+    { "d",  86400*1000000000ull },
+};
 
-    for (size_t i = 0; i < shop__options.len; i++) {
-        const shop_option_t *opt_ptr = &shop__options.items[i];
+static const shop__unit_t shop__count_units[] = {
+    { "k", 1000ull }, { "K", 1000ull },
+    { "M", 1000000ull },
+    { "G", 1000000000ull },
+};
 
-        char short_desc[DESC_WIDTH + 4];
-        const char *desc = opt_ptr->info ? opt_ptr->info : "";
-        if (strlen(desc) > (size_t) DESC_WIDTH) {
-            strncpy(short_desc, desc, DESC_WIDTH - 3);
-            short_desc[DESC_WIDTH - 3] = '\0';
-            strcat(short_desc, "...");
+#define shop__countof(arr) (sizeof(arr)/sizeof((arr)[0]))
+
+// sizes are powers of 1024, a bare number is in bytes
+static bool shop__conv_size(const char *value, void *dst) {
+    uint64_t ip, fp, scale, mult = 1, res;
+    const char *s = shop__fixed(value, &ip, &fp, &scale);
+    if (!s) return false;
+    s += shop__unit(s, shop__size_units, shop__countof(shop__size_units), &mult);
+    if (*s != '\0' || !shop__mul(ip, fp, scale, mult, &res)) return false;
+    memcpy(dst, &res, sizeof(res));
+    return true;
+}
+
+// shop__dur - parse a sequence of '<decimal><unit>', like '1h30m'
+// Return: the end of the duration, NULL if invalid
+static const char *shop__dur(const char *s, uint64_t *out) {
+    uint64_t total = 0;
+    do {
+        uint64_t ip, fp, scale, mult = 0, part;
+        s = shop__fixed(s, &ip, &fp, &scale);
+        if (!s) return NULL;
+        size_t len = shop__unit(s, shop__dur_units, shop__countof(shop__dur_units), &mult);
+        if (len == 0) return NULL;
+        s += len;
+        if (!shop__mul(ip, fp, scale, mult, &part) || total > UINT64_MAX - part) return NULL;
+        total += part;
+    } while ((*s >= '0' && *s <= '9') || *s == '.');
+    *out = total;
+    return s;
+}
+
+// a bare number is in seconds
+static bool shop__conv_dur(const char *value, void *dst) {
+    uint64_t res, ip, fp, scale;
+    const char *s = shop__fixed(value, &ip, &fp, &scale);
+    if (s && *s == '\0') {
+        if (!shop__mul(ip, fp, scale, 1000000000ull, &res)) return false;
+    } else {
+        s = shop__dur(value, &res);
+        if (!s || *s != '\0') return false;
+    }
+    memcpy(dst, &res, sizeof(res));
+    return true;
+}
+
+// '<count>[k|M|G][/[<decimal>]<unit>]', per second by default
+static bool shop__conv_rate(const char *value, void *dst) {
+    shop_rate_t res;
+    uint64_t ip, fp, scale, mult = 1;
+    const char *s = shop__fixed(value, &ip, &fp, &scale);
+    if (!s) return false;
+    s += shop__unit(s, shop__count_units, shop__countof(shop__count_units), &mult);
+    if (!shop__mul(ip, fp, scale, mult, &res.count)) return false;
+
+    res.per_ns = 1000000000ull;
+    if (*s == '/') {
+        s++;
+        if (*s >= 'a' && *s <= 'z') {
+            // '/s' means '/1s'
+            size_t len = shop__unit(s, shop__dur_units, shop__countof(shop__dur_units), &res.per_ns);
+            if (len == 0) return false;
+            s += len;
         } else {
-            strcpy(short_desc, desc);
+            s = shop__dur(s, &res.per_ns);
+            if (!s) return false;
         }
-        printf("-%c      %-*s  %-6s  %-10s  ",
-               opt_ptr->name,
-               DESC_WIDTH, short_desc,
-               opt_ptr->used ? "yes" : "no",
+        if (res.per_ns == 0) return false;
+    }
+    if (*s != '\0') return false;
+    memcpy(dst, &res, sizeof(res));
+    return true;
+}
+
+#define SHOP__MAX_TYPES 64
+
+// indexed by 'shop_type_t'
+static struct {
+    const char *scan_fmt;
+    shop_parse_fn conv;
+    size_t size;
+    bool eager; // converted by 'shop_track' into the typed cache
+} shop__types[SHOP__MAX_TYPES] = {
+    { NULL,  NULL,              0,                    false }, // SHOP_NONE
+    { NULL,  NULL,              0,                    false }, // SHOP_SCANF
+    { "%s",  shop__conv_str,    sizeof(const char *), false },
+    { "%b",  shop__conv_bool,   sizeof(bool),         false },
+    { "%d",  shop__conv_int,    sizeof(int),          false },
+    { "%ld", shop__conv_long,   sizeof(long),         false },
+    { "%f",  shop__conv_float,  sizeof(float),        false },
+    { "%lf", shop__conv_double, sizeof(double),       false },
+    { "%size", shop__conv_size, sizeof(uint64_t),     true  },
+    { "%dur",  shop__conv_dur,  sizeof(uint64_t),     true  },
+    { "%rate", shop__conv_rate, sizeof(shop_rate_t),  true  },
+    { NULL,    NULL,            sizeof(int),          true  }, // SHOP_CHOICE
+    { "%range", NULL,           sizeof(long),         false },
+    { "%dict",  NULL,           0,                    false },
+    { "%subopt", NULL,          0,                    false },
+};
+static size_t shop__ntypes = SHOP_USER;
+
+SHOPDEF shop_type_t shop_register_type(const char *scan_fmt, shop_parse_fn parse, size_t size) {
+    SHOP_ASSERT(shop__ntypes < SHOP__MAX_TYPES, "too many types");
+    SHOP_ASSERT(scan_fmt && parse && size > 0, "invalid type '%s'", scan_fmt ? scan_fmt : "");
+    for (size_t i = SHOP_STR; i < shop__ntypes; i++) {
+        if (!shop__types[i].scan_fmt) continue;
+        SHOP_ASSERT(strcmp(scan_fmt, shop__types[i].scan_fmt) != 0, "type '%s' registered twice", scan_fmt);
+    }
+
+    shop__types[shop__ntypes].scan_fmt = scan_fmt;
+    shop__types[shop__ntypes].conv = parse;
+    shop__types[shop__ntypes].size = size;
+    shop__types[shop__ntypes].eager = true;
+    return (shop_type_t) shop__ntypes++;
+}
+
+// shop__set_fmt - set the scan format and resolve its type once
+static void shop__set_fmt(shop_option_t *opt, const char *scan_fmt) {
+    opt->scan_fmt = scan_fmt;
+    opt->type = SHOP_NONE;
+    if (!scan_fmt || scan_fmt[0] == '\0') return;
+
+    opt->type = SHOP_SCANF;
+    for (size_t i = SHOP_STR; i < shop__ntypes; i++) {
+        if (shop__types[i].scan_fmt && strcmp(scan_fmt, shop__types[i].scan_fmt) == 0) {
+            opt->type = (shop_type_t) i;
+            break;
+        }
+    }
+
+    // a key=value pair has no single variable to go to
+    SHOP_ASSERT(!opt->bind || (opt->type != SHOP_DICT && opt->type != SHOP_SUBOPT),
+                "option '-%c' of type '%s' can not be bound", opt->name, scan_fmt);
+}
+
+SHOPDEF void shop_desc(unsigned char name, const char *scan_fmt, const char *info) {
+    shop_option_t *opt_ptr = shop__find(name);
+    SHOP_ASSERT(opt_ptr, "unknown option: '-%c'", name);
+    shop__set_fmt(opt_ptr, scan_fmt);
+    opt_ptr->info = info;
+}
+
+SHOPDEF void shop_bind(unsigned char name, void *dst, const char *scan_fmt) {
+    shop_option_t *opt_ptr = shop__find(name);
+    SHOP_ASSERT(opt_ptr, "unknown option: '-%c'", name);
+    opt_ptr->bind = dst;
+    if (scan_fmt) shop__set_fmt(opt_ptr, scan_fmt);
+    SHOP_ASSERT(!opt_ptr->take_arg || opt_ptr->type != SHOP_NONE,
+                "option '-%c' takes an argument, bind it with a scan format", name);
+    SHOP_ASSERT(opt_ptr->type != SHOP_DICT && opt_ptr->type != SHOP_SUBOPT,
+                "option '-%c' of type '%s' can not be bound", name, opt_ptr->scan_fmt);
+}
+
+// perfect hash of the choices of an option, allocated in one block
+struct shop__choices {
+    const char *const *names; // points into 'slots'
+    size_t n;
+    uint32_t seed;
+    uint32_t mask;
+    int *slots; // hash slot -> choice index, -1 if empty
+};
+
+static uint32_t shop__hashn(const char *s, size_t len, uint32_t seed) {
+    uint32_t h = 2166136261u ^ seed;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char) s[i];
+        h *= 16777619u;
+    }
+    return h ^ (h >> 16);
+}
+
+static uint32_t shop__hash(const char *s, uint32_t seed) {
+    return shop__hashn(s, strlen(s), seed);
+}
+
+// shop__index_slot - find the slot of a key, or the empty slot for it
+// @items, @size: the indexed vector and the size of an item
+static size_t shop__index_slot(const struct shop__index *ix, const void *items, size_t size,
+                               const char *key, size_t klen) {
+    size_t slot = shop__hashn(key, klen, 0) & ix->mask;
+    for (;; slot = (slot + 1) & ix->mask) {
+        uint32_t i = ix->slots[slot];
+        if (i == 0) return slot;
+        const char *item = (const char *) items + (i-1)*size;
+        const char *k;
+        size_t len;
+        memcpy(&k, item, sizeof(k));
+        memcpy(&len, item + sizeof(k), sizeof(len));
+        if (len == klen && memcmp(k, key, klen) == 0) return slot;
+    }
+}
+
+// shop__index_add - index the last of 'len' items, rehash at half load
+// Note: a key given again points to its last item
+static void shop__index_add(struct shop__index *ix, const void *items, size_t size, size_t len) {
+    const char *k;
+    size_t klen;
+    if (2*(ix->keys + 1) > ix->mask + 1) {
+        size_t slots = ix->slots ? 2*(ix->mask + 1) : 16;
+        free(ix->slots);
+        ix->slots = (uint32_t *) calloc(slots, sizeof(uint32_t));
+        SHOP_ASSERT(ix->slots, "out of memory");
+        ix->mask = slots - 1;
+        ix->keys = 0;
+        // re-insert all but the last item in order, so the last one still wins
+        for (size_t i = 0; i + 1 < len; i++) {
+            const char *item = (const char *) items + i*size;
+            memcpy(&k, item, sizeof(k));
+            memcpy(&klen, item + sizeof(k), sizeof(klen));
+            size_t slot = shop__index_slot(ix, items, size, k, klen);
+            if (ix->slots[slot] == 0) ix->keys++;
+            ix->slots[slot] = (uint32_t) (i + 1);
+        }
+    }
+
+    const char *item = (const char *) items + (len-1)*size;
+    memcpy(&k, item, sizeof(k));
+    memcpy(&klen, item + sizeof(k), sizeof(klen));
+    size_t slot = shop__index_slot(ix, items, size, k, klen);
+    if (ix->slots[slot] == 0) ix->keys++;
+    ix->slots[slot] = (uint32_t) len;
+}
+
+// the index of vector 'v', see 'shop__index_slot' and 'shop__index_add'
+#define shop__index_find(v, key, klen) \
+    (v)->index.slots[shop__index_slot(&(v)->index, (v)->items, sizeof(*(v)->items), (key), (klen))]
+#define shop__index_push(v) shop__index_add(&(v)->index, (v)->items, sizeof(*(v)->items), (v)->len)
+
+SHOPDEF void shop_choices(unsigned char name, const char *const *choices, size_t n) {
+    shop_option_t *opt_ptr = shop__find(name);
+    SHOP_ASSERT(opt_ptr, "unknown option: '-%c'", name);
+    SHOP_ASSERT(opt_ptr->take_arg && n > 0 && n < INT_MAX, "invalid choices for option '-%c'", name);
+
+    // a table of twice the choices at least, grow it if no seed fits
+    size_t size = 2;
+    while (size < 2*n) size *= 2;
+    for (;;) {
+        struct shop__choices *c = (struct shop__choices *) malloc(
+            sizeof(*c) + size*sizeof(int) + n*sizeof(const char *));
+        SHOP_ASSERT(c, "out of memory");
+        c->slots = (int *) (c + 1);
+        c->names = (const char *const *) memcpy(c->slots + size, choices, n*sizeof(const char *));
+        c->n = n;
+        c->mask = (uint32_t) (size - 1);
+
+        for (c->seed = 0; c->seed < 64; c->seed++) {
+            memset(c->slots, 0xff, size*sizeof(int));
+            size_t i = 0;
+            for (; i < n; i++) {
+                uint32_t slot = shop__hash(choices[i], c->seed) & c->mask;
+                if (c->slots[slot] >= 0) break;
+                c->slots[slot] = (int) i;
+            }
+            if (i == n) {
+                if (opt_ptr->choices) free(opt_ptr->choices);
+                opt_ptr->choices = c;
+                opt_ptr->type = SHOP_CHOICE;
+                return;
+            }
+            // identical choices never separate
+            SHOP_ASSERT(strcmp(choices[i], choices[c->slots[shop__hash(choices[i], c->seed) & c->mask]]) != 0,
+                        "choice '%s' of option '-%c' given twice", choices[i], name);
+        }
+        free(c);
+        size *= 2;
+    }
+}
+
+// shop__choose - map the value to its choice index, a hash and one strcmp
+static bool shop__choose(const struct shop__choices *c, const char *value, int *dst) {
+    int idx = c->slots[shop__hash(value, c->seed) & c->mask];
+    if (idx < 0 || strcmp(c->names[idx], value) != 0) return false;
+    *dst = idx;
+    return true;
+}
+
+static void shop__choice_error(const shop_option_t *opt, const char *value) {
+    fprintf(stderr, "ERROR: invalid value '%s' for option '-%c', expect ", value, opt->name);
+    for (size_t i = 0; i < opt->choices->n; i++) {
+        fprintf(stderr, "%s%s", i ? "|" : "", opt->choices->names[i]);
+    }
+    fprintf(stderr, "\n");
+#ifdef SHOP_HAS_WATCH
+    shop__fail();
+#else
+    exit(EXIT_FAILURE);
+#endif
+}
+
+SHOPDEF const shop_option_t *shop_use(unsigned char name) {
+    // the first occurrence is enough to tell
+    if (shop__ctx->lazy.pending) shop__lazy_resolve(name);
+    const shop_option_t *opt_ptr = shop__find(name);
+    if (opt_ptr && opt_ptr->used) return opt_ptr;
+    return NULL;
+}
+
+// shop__range_add - parse a list of ranges like '0-15,32,40-47'
+// Return: false if the list is invalid
+static bool shop__range_add(shop_option_t *opt, const char *value) {
+    if (!opt->ranges) {
+        opt->ranges = (struct shop__ranges *) calloc(1, sizeof(*opt->ranges));
+        SHOP_ASSERT(opt->ranges, "out of memory");
+    }
+    struct shop__ranges *r = opt->ranges;
+
+    const char *s = value;
+    for (;;) {
+        char *end;
+        if (*s < '0' || *s > '9') return false;
+        errno = 0;
+        long lo = strtol(s, &end, 10), hi = lo;
+        if (errno == ERANGE) return false;
+        s = end;
+        if (*s == '-') {
+            s++;
+            if (*s < '0' || *s > '9') return false;
+            hi = strtol(s, &end, 10);
+            if (errno == ERANGE || hi < lo) return false;
+            s = end;
+        }
+
+        size_t count = (size_t) (hi - lo) + 1;
+        if (count == 0 || r->total > SIZE_MAX - count) return false;
+        shop__range_t range = { lo, hi, r->total };
+        shop__push(r, range);
+        r->total += count;
+
+        if (*s == '\0') return true;
+        if (*s++ != ',') return false;
+    }
+}
+
+// shop__range_at - the 'idx'-th integer, a binary search over the ranges
+static long shop__range_at(const struct shop__ranges *r, size_t idx) {
+    size_t lo = 0, hi = r->len;
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo)/2;
+        if (r->items[mid].before <= idx) lo = mid;
+        else hi = mid;
+    }
+    return r->items[lo].lo + (long) (idx - r->items[lo].before);
+}
+
+// shop__dict_add - split 'key=value' pairs in place, nothing is copied
+// @split: split pairs at ',' like getsubopt
+static void shop__dict_add(shop_option_t *opt, const char *value, bool split) {
+    if (!opt->dict) {
+        opt->dict = (struct shop__dict *) calloc(1, sizeof(*opt->dict));
+        SHOP_ASSERT(opt->dict, "out of memory");
+    }
+    struct shop__dict *d = opt->dict;
+
+    const char *s = value;
+    do {
+        const char *end = split ? strchr(s, ',') : NULL;
+        if (!end) end = s + strlen(s);
+        const char *eq = (const char *) memchr(s, '=', (size_t) (end - s));
+
+        shop__pair_t pair;
+        pair.key = s;
+        pair.klen = (size_t) ((eq ? eq : end) - s);
+        pair.val = eq ? eq + 1 : end;
+        pair.vlen = (size_t) (end - pair.val);
+        SHOP_ASSERT(pair.klen > 0, "empty key in '%s' for option '-%c'", value, opt->name);
+        SHOP_ASSERT(d->len < UINT32_MAX, "too many keys for option '-%c'", opt->name);
+        shop__push(d, pair);
+        shop__index_push(d);
+
+        s = *end ? end + 1 : end;
+    } while (*s);
+}
+
+// shop__count - number of values of the option
+static size_t shop__count(const shop_option_t *opt) {
+    return opt->ranges ? opt->ranges->total : opt->len;
+}
+
+// shop__scan_type - the type 'shop_sget' reads the option as
+// Note: numbers keep the rules of 'sscanf', '42abc' reads 42, only
+//       'shop_get_xxx' asks for the whole value
+static shop_type_t shop__scan_type(const shop_option_t *opt) {
+    if (opt->type >= SHOP_INT && opt->type <= SHOP_DOUBLE) return SHOP_SCANF;
+    return opt->type;
+}
+
+// shop__scan - convert a raw value of the option as 'shop_sget' does
+static bool shop__scan(const shop_option_t *opt, const char *value, void *dst) {
+    if (shop__scan_type(opt) == SHOP_SCANF) return sscanf(value, opt->scan_fmt, dst) == 1;
+    return shop__types[opt->type].conv(value, dst);
+}
+
+// shop__value - read a value of the option as 'type'
+// Note: the typed cache serves its own type, other types are converted
+static bool shop__value(const shop_option_t *opt, size_t idx, shop_type_t type, void *dst) {
+    if (opt->ranges) {
+        long v = shop__range_at(opt->ranges, idx);
+        if (type == SHOP_RANGE || type == SHOP_LONG) {
+            *((long*) dst) = v;
+        } else if (type == SHOP_INT && v <= INT_MAX) {
+            *((int*) dst) = (int) v;
+        } else {
+            return false;
+        }
+        return true;
+    }
+    if (opt->type == SHOP_CHOICE && type == SHOP_INT) type = SHOP_CHOICE;
+    if (opt->data && type == opt->type) {
+        size_t size = shop__types[type].size;
+        memcpy(dst, opt->data + idx*size, size);
+        return true;
+    }
+    if (type == SHOP_SCANF) return sscanf(opt->items[idx], opt->scan_fmt, dst) == 1;
+    if (!shop__types[type].conv) return false;
+    return shop__types[type].conv(opt->items[idx], dst);
+}
+
+// shop__reset - drop the values of the option, keep the memory
+static void shop__reset(shop_option_t *opt) {
+    opt->len = 0;
+    opt->is_default = false;
+    if (opt->borrowed) {
+        opt->items = NULL;
+        opt->cap = 0;
+        opt->borrowed = false;
+    }
+    if (opt->ranges) {
+        opt->ranges->len = 0;
+        opt->ranges->total = 0;
+    }
+    if (opt->dict) {
+        opt->dict->len = 0;
+        opt->dict->index.keys = 0;
+        memset(opt->dict->index.slots, 0, (opt->dict->index.mask + 1)*sizeof(uint32_t));
+    }
+}
+
+// shop__add - add an occurrence to the values of the option
+// @value: the option value, NULL for an option without argument
+// Note: only 'shop_flatten' adds, the sources go through 'shop__record'
+static void shop__add(shop_option_t *opt, const char *value) {
+    opt->used = true;
+    opt->count++;
+    if (!value || opt->mode == SHOP_COUNT) {
+        if (opt->bind && opt->mode == SHOP_COUNT) *((int*) opt->bind) = (int) opt->count;
+        else if (opt->bind) *((bool*) opt->bind) = true;
+        return;
+    }
+    if (opt->mode == SHOP_FIRST && opt->len > 0) return;
+    if (opt->mode == SHOP_LAST) shop__reset(opt);
+
+    shop__push(opt, value);
+
+    // convert a registered type once into the typed cache
+    if (shop__types[opt->type].eager) {
+        size_t size = shop__types[opt->type].size;
+        if (opt->data_cap < opt->cap) {
+            opt->data = (unsigned char *) realloc(opt->data, opt->cap*size);
+            SHOP_ASSERT(opt->data, "out of memory");
+            opt->data_cap = opt->cap;
+        }
+        void *slot = opt->data + (opt->len-1)*size;
+        if (opt->choices) {
+            if (!shop__choose(opt->choices, value, (int *) slot)) shop__choice_error(opt, value);
+        } else {
+            SHOP_ASSERT(shop__types[opt->type].conv(value, slot),
+                        "invalid value '%s' for option '-%c'", value, opt->name);
+        }
+    } else if (opt->type == SHOP_RANGE) {
+        SHOP_ASSERT(shop__range_add(opt, value), "invalid range '%s' for option '-%c'", value, opt->name);
+    } else if (opt->type == SHOP_DICT || opt->type == SHOP_SUBOPT) {
+        shop__dict_add(opt, value, opt->type == SHOP_SUBOPT);
+    }
+
+    if (opt->bind && opt->type != SHOP_NONE) {
+        SHOP_ASSERT(shop__value(opt, shop__count(opt)-1, shop__scan_type(opt), opt->bind),
+                    "invalid value '%s' for option '-%c'", value, opt->name);
+    }
+}
+
+static shop__layer_t *shop__layer(shop_option_t *opt, shop_src_t src) {
+    if (!opt->layers) {
+        opt->layers = (struct shop__layers *) calloc(1, sizeof(*opt->layers));
+        SHOP_ASSERT(opt->layers, "out of memory");
+    }
+    return &opt->layers->src[src];
+}
+
+// shop__keeps_all - whether the option keeps every value of a source
+static bool shop__keeps_all(const shop_option_t *opt) {
+    return opt->mode == SHOP_APPEND || opt->mode == SHOP_MERGE;
+}
+
+// shop__record - record an occurrence from a source
+// @value: the option value, NULL for an option without argument
+// Note: the mode applies per source, so SHOP_LAST, SHOP_FIRST and
+//       SHOP_COUNT keep O(1) memory here too
+// Return: the index of the value in the source, SHOP_NOVALUE if not kept
+static uint32_t shop__record(shop_option_t *opt, shop_src_t src, const char *value) {
+    shop__layer_t *layer = shop__layer(opt, src);
+    layer->count++;
+    if (!value || opt->mode == SHOP_COUNT) return SHOP_NOVALUE;
+    if (opt->mode == SHOP_FIRST && layer->len > 0) return SHOP_NOVALUE;
+    if (opt->mode == SHOP_LAST) layer->len = 0;
+    shop__push(layer, value);
+    return (uint32_t) (layer->len - 1);
+}
+
+// shop__record_value - record a value of a source other than argv
+// Note: a flag is set by a true "%b" value
+static void shop__record_value(shop_option_t *opt, shop_src_t src, const char *value) {
+    if (opt->take_arg) {
+        shop__record(opt, src, value);
+    } else {
+        bool on;
+        shop__conv_bool(value, &on);
+        if (on) shop__record(opt, src, NULL);
+    }
+}
+
+// shop__flatten_opt - rebuild the values of the option from its sources
+static void shop__flatten_opt(shop_option_t *opt) {
+    shop__reset(opt);
+    opt->used = false;
+    opt->count = 0;
+    opt->src = SHOP_SRC_DEFAULT;
+    if (!opt->layers) return;
+    const shop__layer_t *src = opt->layers->src;
+
+    int top = SHOP_SRC_COUNT - 1;
+    while (top > SHOP_SRC_DEFAULT && src[top].count == 0) top--;
+
+    if (top == SHOP_SRC_DEFAULT) {
+        // converted like a given value, but the option stays unused
+        for (size_t i = 0; i < src[top].len; i++) shop__add(opt, src[top].items[i]);
+        opt->used = false;
+        opt->count = 0;
+        opt->is_default = src[top].len > 0;
+        return;
+    }
+
+    opt->src = (shop_src_t) top;
+    if (!opt->take_arg || opt->mode == SHOP_COUNT) {
+        // only the count of the winner matters
+        opt->count = src[top].count - 1;
+        shop__add(opt, NULL);
+        return;
+    }
+
+    // a source keeps its values as 'shop__add' would, so plain strings
+    // of a single source are read from its array, not copied again
+    if (opt->mode != SHOP_MERGE && !opt->bind && !shop__types[opt->type].eager
+     && opt->type != SHOP_RANGE && opt->type != SHOP_DICT && opt->type != SHOP_SUBOPT) {
+        free((void *) opt->items);
+        opt->items = src[top].items;
+        opt->len = src[top].len;
+        opt->cap = 0;
+        opt->borrowed = true;
+        opt->used = true;
+        opt->count = src[top].count;
+        return;
+    }
+
+    int from = opt->mode == SHOP_MERGE ? SHOP_SRC_DEFAULT + 1 : top;
+    size_t count = 0;
+    for (int s = from; s <= top; s++) {
+        for (size_t i = 0; i < src[s].len; i++) shop__add(opt, src[s].items[i]);
+        count += src[s].count;
+    }
+    opt->count = count;
+}
+
+SHOPDEF void shop_flatten(void) {
+    shop__load_defs();
+    if (shop__ctx->lazy.pending) {
+        shop__lazy_resolve(0);
+        return;
+    }
+    for (size_t i = 0; i < shop__ctx->options.len; i++) {
+        shop__flatten_opt(&shop__ctx->options.items[i]);
+    }
+}
+
+SHOPDEF void shop_mode(unsigned char name, shop_mode_t mode) {
+    shop_option_t *opt_ptr = shop__find(name);
+    SHOP_ASSERT(opt_ptr, "unknown option: '-%c'", name);
+    opt_ptr->mode = mode;
+}
+
+SHOPDEF size_t shop_count(unsigned char name) {
+    const shop_option_t *opt_ptr = shop__query(name);
+    return opt_ptr ? opt_ptr->count : 0;
+}
+
+SHOPDEF void shop_default(unsigned char name, const char *value) {
+    shop_option_t *opt_ptr = shop__find(name);
+    SHOP_ASSERT(opt_ptr, "unknown option: '-%c'", name);
+    SHOP_ASSERT(opt_ptr->take_arg && value, "invalid default for option '-%c'", name);
+
+    // convert it like a given value, then mark it as the default
+    if (opt_ptr->layers) {
+        opt_ptr->layers->src[SHOP_SRC_DEFAULT].len = 0;
+        opt_ptr->layers->src[SHOP_SRC_DEFAULT].count = 0;
+    }
+    shop__record(opt_ptr, SHOP_SRC_DEFAULT, value);
+    shop__flatten_opt(opt_ptr);
+    opt_ptr->def = value;
+
+    // lazy types are converted on read, check them now
+    if (opt_ptr->type >= SHOP_STR && opt_ptr->type <= SHOP_DOUBLE) {
+        union { const char *s; long l; double d; } tmp;
+        SHOP_ASSERT(shop__scan(opt_ptr, value, &tmp),
+                    "invalid default '%s' for option '-%c'", value, name);
+    }
+}
+
+#ifdef SHOP_HAS_DEFINE
+#ifdef __cplusplus
+extern "C" {
+#endif
+// defined by the linker if any 'shop_opts' section exists
+extern const shop_def_t __start_shop_opts[] __attribute__((weak));
+extern const shop_def_t __stop_shop_opts[] __attribute__((weak));
+#ifdef __cplusplus
+}
+#endif
+
+static int shop__def_cmp(const void *a, const void *b) {
+    const shop_def_t *x = *(const shop_def_t *const *) a;
+    const shop_def_t *y = *(const shop_def_t *const *) b;
+    return (int) x->name - (int) y->name;
+}
+#endif
+
+// shop__load_defs - register the options of 'SHOP_DEFINE', sorted by name
+static void shop__load_defs(void) {
+    if (shop__ctx != &shop__default_ctx || shop__ctx->defs_loaded) return;
+    shop__ctx->defs_loaded = true;
+
+#ifdef SHOP_HAS_DEFINE
+    const shop_def_t *first = __start_shop_opts;
+    const shop_def_t *last = __stop_shop_opts;
+    if (!first || first == last) return;
+
+    size_t n = (size_t) (last - first);
+    const shop_def_t **defs = (const shop_def_t **) malloc(n*sizeof(*defs));
+    SHOP_ASSERT(defs, "out of memory");
+    for (size_t i = 0; i < n; i++) defs[i] = &first[i];
+    qsort((void *) defs, n, sizeof(*defs), shop__def_cmp);
+
+    for (size_t i = 0; i < n; i++) {
+        const shop_def_t *def = defs[i];
+        SHOP_ASSERT(shop__ctx->map[def->name] == 0, "option '-%c' defined twice", def->name);
+
+        shop_option_t opt;
+        memset(&opt, 0, sizeof(opt));
+        opt.name = def->name;
+        opt.take_arg = def->take_arg;
+        opt.bind = def->bind;
+        shop__set_fmt(&opt, def->scan_fmt);
+        opt.info = def->info;
+        shop__push(&shop__ctx->options, opt);
+        shop__ctx->map[opt.name] = (unsigned char) shop__ctx->options.len;
+    }
+    free((void *) defs);
+#endif
+}
+
+static struct shop__env *shop__env_get(void) {
+    if (!shop__ctx->env) {
+        shop__ctx->env = (struct shop__env *) calloc(1, sizeof(*shop__ctx->env));
+        SHOP_ASSERT(shop__ctx->env, "out of memory");
+    }
+    return shop__ctx->env;
+}
+
+SHOPDEF void shop_env(unsigned char name, const char *var) {
+    SHOP_ASSERT(shop__find(name), "unknown option: '-%c'", name);
+    SHOP_ASSERT(var && var[0] != '\0', "invalid variable for option '-%c'", name);
+
+    struct shop__env *env = shop__env_get();
+    shop__envvar_t v = { var, strlen(var), name };
+    shop__push(env, v);
+    shop__index_push(env);
+}
+
+SHOPDEF void shop_env_prefix(const char *prefix) {
+    shop__env_get()->prefix = prefix;
+}
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+extern char **environ;
+#ifdef __cplusplus
+}
+#endif
+
+static void shop__env_add(unsigned char name, const char *value) {
+    shop_option_t *opt = shop__find(name);
+    if (opt) shop__record_value(opt, SHOP_SRC_ENV, value);
+}
+
+// shop__env_scan - one pass over 'environ', it replaces the last one
+static void shop__env_scan(void) {
+    const struct shop__env *env = shop__ctx->env;
+    if (!env || !environ) return;
+    for (size_t i = 0; i < shop__ctx->options.len; i++) {
+        shop_option_t *opt = &shop__ctx->options.items[i];
+        if (!opt->layers) continue;
+        opt->layers->src[SHOP_SRC_ENV].len = 0;
+        opt->layers->src[SHOP_SRC_ENV].count = 0;
+    }
+
+    size_t plen = env->prefix ? strlen(env->prefix) : 0;
+
+    for (char **ep = environ; *ep; ep++) {
+        const char *entry = *ep;
+        const char *eq = strchr(entry, '=');
+        if (!eq) continue;
+        size_t len = (size_t) (eq - entry);
+
+        if (env->len > 0) {
+            uint32_t i = shop__index_find(env, entry, len);
+            if (i != 0) {
+                shop__env_add(env->items[i-1].name, eq + 1);
+                continue;
+            }
+        }
+        if (plen > 0 && len == plen + 1 && memcmp(entry, env->prefix, plen) == 0) {
+            shop__env_add((unsigned char) entry[plen], eq + 1);
+        }
+    }
+}
+
+// shop__file_keep - keep a buffer alive until 'shop_free'
+static void shop__file_keep(char *addr, size_t len, bool mapped) {
+    if (!shop__ctx->files) {
+        shop__ctx->files = (struct shop__files *) calloc(1, sizeof(*shop__ctx->files));
+        SHOP_ASSERT(shop__ctx->files, "out of memory");
+    }
+    shop__file_t f = { addr, len, mapped };
+    shop__push(shop__ctx->files, f);
+}
+
+// shop__file_read - map the file privately writable, or read it
+// Note: the buffer has a '\0' after the content if 'terminated'
+static char *shop__file_read(const char *path, size_t *len, bool *terminated) {
+#ifdef SHOP__HAS_MMAP
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return NULL;
+    }
+    *len = (size_t) st.st_size;
+    if (*len == 0) {
+        close(fd);
+        *terminated = true;
+        return (char *) "";
+    }
+
+    // writes only touch the pages of the values, they stay copy-on-write
+    void *addr = mmap(NULL, *len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) return NULL;
+    shop__file_keep((char *) addr, *len, true);
+    // the rest of the last page is zero
+    long page = sysconf(_SC_PAGESIZE);
+    *terminated = page > 0 && *len % (size_t) page != 0;
+    return (char *) addr;
+#else
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return NULL;
+    char *buf = NULL;
+    size_t cap = 0;
+    *len = 0;
+    for (;;) {
+        if (*len + 4096 + 1 > cap) {
+            cap = cap < 8192 ? 8192 : 2*cap;
+            buf = (char *) realloc(buf, cap);
+            SHOP_ASSERT(buf, "out of memory");
+        }
+        size_t n = fread(buf + *len, 1, 4096, fp);
+        *len += n;
+        if (n < 4096) break;
+    }
+    fclose(fp);
+    buf[*len] = '\0';
+    shop__file_keep(buf, *len, false);
+    *terminated = true;
+    return buf;
+#endif
+}
+
+SHOPDEF bool shop_load_file(const char *path, const char *section) {
+    size_t len;
+    bool terminated;
+    char *buf = shop__file_read(path, &len, &terminated);
+    if (!buf) return false;
+
+    size_t slen = section ? strlen(section) : 0;
+    bool in_section = section == NULL;
+    char *p = buf, *end = buf + len;
+    while (p < end) {
+        char *eol = (char *) memchr(p, '\n', (size_t) (end - p));
+        if (!eol) eol = end;
+        char *line = p;
+        p = eol + 1;
+
+        while (line < eol && (*line == ' ' || *line == '\t')) line++;
+        if (line == eol) continue;
+
+        if (*line == '[') {
+            char *close = (char *) memchr(line, ']', (size_t) (eol - line));
+            in_section = section && close && (size_t) (close - line - 1) == slen
+                      && memcmp(line + 1, section, slen) == 0;
+            continue;
+        }
+        if (!in_section || *line == ';' || *line == '#') continue;
+
+        // 'n = value', the key is one option name
+        char *key = line++;
+        while (line < eol && (*line == ' ' || *line == '\t')) line++;
+        if (line == eol || *line != '=') continue;
+        shop_option_t *opt = shop__find((unsigned char) *key);
+        if (!opt) continue;
+
+        char *value = line + 1;
+        while (value < eol && (*value == ' ' || *value == '\t')) value++;
+        char *vend = eol;
+        while (vend > value && (vend[-1] == ' ' || vend[-1] == '\t' || vend[-1] == '\r')) vend--;
+
+        if (vend == end && !terminated) {
+            // the last value ends the page, copy it to terminate it
+            size_t vlen = (size_t) (vend - value);
+            char *copy = (char *) malloc(vlen + 1);
+            SHOP_ASSERT(copy, "out of memory");
+            memcpy(copy, value, vlen);
+            copy[vlen] = '\0';
+            shop__file_keep(copy, vlen + 1, false);
+            value = copy;
+        } else {
+            *vend = '\0';
+        }
+        shop__record_value(opt, SHOP_SRC_FILE, value);
+    }
+    shop_flatten();
+    return true;
+}
+
+SHOPDEF void shop_subcmd(const char *name, void (*setup)(void), const char *info) {
+    SHOP_ASSERT(name && name[0] != '\0' && name[0] != '-', "invalid subcommand name");
+    if (!shop__ctx->subcmds) {
+        shop__ctx->subcmds = (struct shop__subcmds *) calloc(1, sizeof(*shop__ctx->subcmds));
+        SHOP_ASSERT(shop__ctx->subcmds, "out of memory");
+    }
+    struct shop__subcmds *s = shop__ctx->subcmds;
+    shop__subcmd_t c = { name, strlen(name), setup, info };
+    SHOP_ASSERT(!s->index.slots || shop__index_find(s, name, c.len) == 0,
+                "subcommand '%s' already declared", name);
+    shop__push(s, c);
+    shop__index_push(s);
+}
+
+SHOPDEF const char *shop_selected(shop_ctx_t **ctx) {
+    shop__lazy_finish();
+    const struct shop__subcmds *s = shop__ctx->subcmds;
+    if (ctx) *ctx = s ? s->child : NULL;
+    return s ? s->selected : NULL;
+}
+
+// shop__subcmd_track - build the selected subcommand and track the rest of argv
+// @argv: starts at the subcommand name
+static void shop__subcmd_track(int argc, char **argv) {
+    struct shop__subcmds *s = shop__ctx->subcmds;
+    uint32_t i = shop__index_find(s, argv[0], strlen(argv[0]));
+    SHOP_ASSERT(i != 0, "unknown subcommand: '%s'", argv[0]);
+    if (s->child) shop__drop(s->child);
+    s->selected = s->items[i-1].name;
+    s->child = (shop_ctx_t *) calloc(1, sizeof(*s->child));
+    SHOP_ASSERT(s->child, "out of memory");
+
+    s->child->events.on = shop__ctx->events.on;
+    shop_ctx_t *prev = shop_switch(s->child);
+    if (s->items[i-1].setup) s->items[i-1].setup();
+    shop_track(argc, argv);
+    shop_switch(prev);
+}
+
+SHOPDEF void shop_events(bool on) {
+    shop__ctx->events.on = on;
+}
+
+SHOPDEF const shop_event_t *shop_event_log(size_t *len) {
+    shop__lazy_finish();
+    *len = shop__ctx->events.len;
+    return shop__ctx->events.items;
+}
+
+// shop__track_record - record an occurrence of argv, and log it
+static void shop__track_record(shop_option_t *opt, const char *value, int arg) {
+    uint32_t idx = shop__record(opt, SHOP_SRC_ARGV, value);
+    if (!shop__ctx->events.on) return;
+    shop_event_t ev = { opt->name, idx, (uint32_t) arg };
+    shop__push(&shop__ctx->events, ev);
+}
+
+// shop__events_fix - turn the indices of the argv source into the ones of the values
+static void shop__events_fix(void) {
+    bool seen[256] = {0};
+    for (size_t i = shop__ctx->events.len; i-- > 0; ) {
+        shop_event_t *ev = &shop__ctx->events.items[i];
+        if (ev->value == SHOP_NOVALUE) continue;
+        const shop_option_t *opt = shop__find(ev->name);
+        if (opt->mode == SHOP_LAST) {
+            // the source keeps only the last one
+            if (seen[ev->name]) ev->value = SHOP_NOVALUE;
+            seen[ev->name] = true;
+        } else if (shop__keeps_all(opt)) {
+            // argv comes after the values of the lower sources merged
+            ev->value += (uint32_t) (opt->len - opt->layers->src[SHOP_SRC_ARGV].len);
+        }
+    }
+}
+
+// shop__track_scan - scan argv from 'i', to the end or past the first occurrence of 'want'
+// @want: the option to stop at, NULL for none
+// Return: the index of the next argument to scan
+static int shop__track_scan(int argc, char **argv, int i, const shop_option_t *want) {
+    for (; i < argc; i++) {
+        const char *arg = argv[i];
+
+        // skip non-option arg, unless it selects a subcommand
+        if (arg[0] != '-') {
+            if (!shop__ctx->subcmds) continue;
+            shop__subcmd_track(argc - i, argv + i);
+            return argc;
+        }
+
+        // handle current option (may combined, -rhp)
+        bool has_param_in_next_arg = false;
+        for (int j = 1; arg[j] != '\0'; j++) {
+            char name = arg[j];
+            shop_option_t *opt = shop__find(name);
+            SHOP_ASSERT(opt, "unknown option: '-%c'", name);
+
+            // check if the option param is in next cmdline arg
+            // -f data.txt or -fdata.txt
+            if (opt->take_arg) {
+                if (arg[j+1] != '\0') shop__track_record(opt, arg + j + 1, i);
+                else has_param_in_next_arg = true;
+                break;
+            }
+            shop__track_record(opt, NULL, i);
+        }
+
+        // handle next option argument if it is
+        if (has_param_in_next_arg) {
+            i++; // skip current option
+            SHOP_ASSERT(i < argc, "option '%s' require argument but not supply", arg);
+            // find the option which need this argument
+            for (int j = 1; arg[j] != '\0'; j++) {
+                shop_option_t *opt = shop__find(arg[j]);
+                if (opt && opt->take_arg) {
+                    shop__track_record(opt, argv[i], i - 1);
+                    break;
+                }
+            }
+        }
+
+        if (want && want->layers->src[SHOP_SRC_ARGV].count > 0) return i + 1;
+    }
+    return argc;
+}
+
+// shop__track_end - the steps of 'shop_track' after argv
+static void shop__track_end(void) {
+    shop__env_scan();
+    shop_flatten();
+    shop__events_fix();
+}
+
+static void shop__lazy_resolve(unsigned char name) {
+    shop_option_t *opt = name ? shop__find(name) : NULL;
+    int argc = shop__ctx->lazy.argc;
+    char **argv = shop__ctx->lazy.argv;
+
+    // the first occurrence decides a flag or a SHOP_FIRST option
+    if (opt && opt->mode != SHOP_COUNT && (!opt->take_arg || opt->mode == SHOP_FIRST)) {
+        const shop__layer_t *layer = shop__layer(opt, SHOP_SRC_ARGV);
+        if (layer->count == 0) {
+            shop__ctx->lazy.next = shop__track_scan(argc, argv, shop__ctx->lazy.next, opt);
+        }
+        if (layer->count > 0) {
+            shop__flatten_opt(opt);
+            return;
+        }
+    }
+
+    shop__ctx->lazy.next = shop__track_scan(argc, argv, shop__ctx->lazy.next, NULL);
+    shop__ctx->lazy.pending = false;
+    shop__track_end();
+}
+
+SHOPDEF void shop_threads(int n) {
+    shop__ctx->threads = n;
+}
+
+#ifdef SHOP__HAS_THREADS
+// the workers of 'shop__exec', started on demand and kept for the process
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t wake;   // a job is posted
+    pthread_cond_t done;   // the tasks of the job are done
+    size_t nthreads;
+    bool busy;             // a job runs, another caller runs its tasks alone
+    bool atfork;
+    unsigned long gen;     // job number, a worker joins each once
+    shop_task_fn task;
+    void *arg;
+    size_t n, next, left;
+} shop__pool = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER,
+                 0, false, false, 0, NULL, NULL, 0, 0, 0 };
+
+// shop__pool_work - run the unclaimed tasks of the job, with the lock held
+static void shop__pool_work(void) {
+    while (shop__pool.next < shop__pool.n) {
+        size_t i = shop__pool.next++;
+        pthread_mutex_unlock(&shop__pool.lock);
+        shop__pool.task(shop__pool.arg, i);
+        pthread_mutex_lock(&shop__pool.lock);
+        if (--shop__pool.left == 0) pthread_cond_broadcast(&shop__pool.done);
+    }
+}
+
+// @arg: the job number before the one the worker is started for
+static void *shop__pool_run(void *arg) {
+    unsigned long seen = (unsigned long) (uintptr_t) arg;
+    pthread_mutex_lock(&shop__pool.lock);
+    for (;;) {
+        while (shop__pool.gen == seen) pthread_cond_wait(&shop__pool.wake, &shop__pool.lock);
+        seen = shop__pool.gen;
+        shop__pool_work();
+    }
+    return NULL;
+}
+
+// the workers are gone in a forked child, it starts its own
+static void shop__pool_child(void) {
+    pthread_mutex_init(&shop__pool.lock, NULL);
+    pthread_cond_init(&shop__pool.wake, NULL);
+    pthread_cond_init(&shop__pool.done, NULL);
+    shop__pool.nthreads = 0;
+    shop__pool.busy = false;
+}
+#endif
+
+// shop__exec - the internal executor, a pool of at most 63 workers and this thread
+static void shop__exec(void *user, shop_task_fn task, void *arg, size_t n) {
+    (void) user;
+#ifdef SHOP__HAS_THREADS
+    if (n > 1) {
+        pthread_mutex_lock(&shop__pool.lock);
+        if (!shop__pool.busy) {
+            shop__pool.busy = true;
+            if (!shop__pool.atfork) shop__pool.atfork = pthread_atfork(NULL, NULL, shop__pool_child) == 0;
+            while (shop__pool.atfork && shop__pool.nthreads < n - 1 && shop__pool.nthreads < 63) {
+                pthread_t thread;
+                void *gen = (void *) (uintptr_t) shop__pool.gen;
+                if (pthread_create(&thread, NULL, shop__pool_run, gen) != 0) break;
+                pthread_detach(thread);
+                shop__pool.nthreads++;
+            }
+            shop__pool.task = task;
+            shop__pool.arg = arg;
+            shop__pool.n = n;
+            shop__pool.next = 0;
+            shop__pool.left = n;
+            shop__pool.gen++;
+            pthread_cond_broadcast(&shop__pool.wake);
+            // the tasks no worker took run here
+            shop__pool_work();
+            while (shop__pool.left > 0) pthread_cond_wait(&shop__pool.done, &shop__pool.lock);
+            shop__pool.busy = false;
+            pthread_mutex_unlock(&shop__pool.lock);
+            return;
+        }
+        pthread_mutex_unlock(&shop__pool.lock);
+    }
+#endif
+    for (size_t i = 0; i < n; i++) task(arg, i);
+}
+
+#ifdef SHOP__HAS_THREADS
+// an occurrence found by a chunk
+typedef struct {
+    unsigned char opt;  // option index
+    uint32_t arg;
+    const char *value;  // NULL for a flag
+} shop__occ_t;
+
+// a chunk of argv for 'shop__track_parallel'
+typedef struct {
+    shop_ctx_t *ctx;
+    int argc;
+    char **argv;
+    int start;          // not the value of the previous argument
+    int end;
+    struct {
+        shop__occ_t *items;
+        size_t len;
+        size_t cap;
+    } occs;
+    size_t *nvals;      // per option, values in the chunk
+    size_t *cursor;     // per option, global index of the next value
+    const char **first; // per option, first and last value in the chunk
+    const char **last;
+    size_t events;      // index of the first event
+    int err;            // argv index of the first error, 'argc' if none
+    char err_name;      // the unknown option, 0 for a missing argument
+} shop__chunk_t;
+
+// shop__dangling - whether the argument ends with an option waiting for the next one
+static bool shop__dangling(const char *arg) {
+    if (arg[0] != '-') return false;
+    for (int j = 1; arg[j] != '\0'; j++) {
+        const shop_option_t *opt = shop__find(arg[j]);
+        if (!opt) return false;
+        if (opt->take_arg) return arg[j+1] == '\0';
+    }
+    return false;
+}
+
+// shop__chunk_scan - collect the occurrences of a chunk, like 'shop__track_scan'
+static void shop__chunk_scan(void *arg, size_t t) {
+    shop__chunk_t *c = (shop__chunk_t *) arg + t;
+    shop_switch(c->ctx);
+    for (int i = c->start; i < c->end; i++) {
+        const char *a = c->argv[i];
+        if (a[0] != '-') continue;
+
+        int taker = -1;
+        for (int j = 1; a[j] != '\0'; j++) {
+            const shop_option_t *opt = shop__find(a[j]);
+            if (!opt) {
+                c->err = i;
+                c->err_name = a[j];
+                return;
+            }
+            unsigned char idx = (unsigned char) (c->ctx->map[(unsigned char) a[j]] - 1);
+            const char *value = NULL;
+            if (opt->take_arg) {
+                if (a[j+1] == '\0') {
+                    taker = idx;
+                    break;
+                }
+                value = a + j + 1;
+            }
+            shop__occ_t occ = { idx, (uint32_t) i, value };
+            shop__push(&c->occs, occ);
+            if (value) break;
+        }
+
+        if (taker >= 0) {
+            if (i + 1 >= c->argc) {
+                c->err = i;
+                return;
+            }
+            shop__occ_t occ = { (unsigned char) taker, (uint32_t) i, c->argv[++i] };
+            shop__push(&c->occs, occ);
+        }
+    }
+
+    for (size_t k = 0; k < c->occs.len; k++) {
+        const shop__occ_t *occ = &c->occs.items[k];
+        if (!occ->value) continue;
+        if (c->nvals[occ->opt]++ == 0) c->first[occ->opt] = occ->value;
+        c->last[occ->opt] = occ->value;
+    }
+}
+
+// shop__chunk_place - put the values and the events of a chunk at their index
+static void shop__chunk_place(void *arg, size_t t) {
+    shop__chunk_t *c = (shop__chunk_t *) arg + t;
+    for (size_t k = 0; k < c->occs.len; k++) {
+        const shop__occ_t *occ = &c->occs.items[k];
+        shop_option_t *opt = &c->ctx->options.items[occ->opt];
+        uint32_t value = SHOP_NOVALUE;
+        if (occ->value && opt->mode != SHOP_COUNT) {
+            shop__layer_t *layer = &opt->layers->src[SHOP_SRC_ARGV];
+            size_t g = c->cursor[occ->opt]++;
+            if (shop__keeps_all(opt)) {
+                layer->items[g] = occ->value;
+                value = (uint32_t) g;
+            } else if (opt->mode == SHOP_LAST || g == 0) {
+                // the same indices as 'shop__record' gives
+                value = 0;
+            }
+        }
+        if (c->ctx->events.on) {
+            shop_event_t ev = { opt->name, value, occ->arg };
+            c->ctx->events.items[c->events + k] = ev;
+        }
+    }
+}
+
+// shop__track_parallel - 'shop__track_scan' of the whole argv on 'n' threads
+static void shop__track_parallel(int argc, char **argv, int n) {
+    shop_ctx_t *ctx = shop__ctx;
+    size_t nopts = ctx->options.len;
+    shop__chunk_t *chunks = (shop__chunk_t *) calloc((size_t) n, sizeof(*chunks));
+    size_t *counts = (size_t *) calloc((size_t) n*nopts*2, sizeof(size_t));
+    const char **values = (const char **) calloc((size_t) n*nopts*2, sizeof(const char *));
+    SHOP_ASSERT(chunks && counts && values, "out of memory");
+
+    // a start is moved past a value, the previous argument takes it if it
+    // ends a run of dangling options of odd length
+    for (int t = 0; t < n; t++) {
+        shop__chunk_t *c = &chunks[t];
+        c->ctx = ctx;
+        c->argc = argc;
+        c->argv = argv;
+        c->start = 1 + (int) ((long long) (argc - 1)*t/n);
+        c->end = 1 + (int) ((long long) (argc - 1)*(t + 1)/n);
+        c->err = argc;
+        c->nvals = counts + (size_t) t*nopts*2;
+        c->cursor = c->nvals + nopts;
+        c->first = values + (size_t) t*nopts*2;
+        c->last = c->first + nopts;
+        if (t == 0) continue;
+        int run = 0;
+        while (c->start - 1 - run >= 1 && shop__dangling(argv[c->start - 1 - run])) run++;
+        if (run % 2 == 1) c->start++;
+        chunks[t-1].end = c->start;
+    }
+
+    shop__exec(NULL, shop__chunk_scan, chunks, (size_t) n);
+
+    for (int t = 0; t < n; t++) {
+        const shop__chunk_t *c = &chunks[t];
+        if (c->err == argc) continue;
+        SHOP_ASSERT(!c->err_name, "unknown option: '-%c'", c->err_name);
+        SHOP_ASSERT(false, "option '%s' require argument but not supply", argv[c->err]);
+    }
+
+    // prefix sum of the values of each option over the chunks
+    for (size_t o = 0; o < nopts; o++) {
+        shop_option_t *opt = &ctx->options.items[o];
+        shop__layer_t *layer = shop__layer(opt, SHOP_SRC_ARGV);
+        size_t start = shop__keeps_all(opt) ? layer->len : (opt->mode == SHOP_FIRST && layer->len > 0);
+        size_t total = 0;
+        const char *first = NULL, *last = NULL;
+        for (int t = 0; t < n; t++) {
+            chunks[t].cursor[o] = start + total;
+            total += chunks[t].nvals[o];
+            if (chunks[t].nvals[o] == 0) continue;
+            if (!first) first = chunks[t].first[o];
+            last = chunks[t].last[o];
+        }
+        if (total == 0 || opt->mode == SHOP_COUNT) continue;
+        if (shop__keeps_all(opt)) {
+            if (layer->cap < layer->len + total) {
+                layer->cap = layer->len + total;
+                *(void **) &layer->items = realloc((void *) layer->items, layer->cap*sizeof(*layer->items));
+                SHOP_ASSERT(layer->items, "out of memory");
+            }
+            layer->len += total;
+        } else if (opt->mode == SHOP_LAST) {
+            layer->len = 0;
+            shop__push(layer, last);
+        } else if (layer->len == 0) {
+            shop__push(layer, first);
+        }
+    }
+
+    size_t nevents = 0;
+    for (int t = 0; t < n; t++) {
+        chunks[t].events = nevents;
+        nevents += chunks[t].occs.len;
+        for (size_t k = 0; k < chunks[t].occs.len; k++) {
+            ctx->options.items[chunks[t].occs.items[k].opt].layers->src[SHOP_SRC_ARGV].count++;
+        }
+    }
+    if (ctx->events.on) {
+        if (ctx->events.cap < nevents) {
+            ctx->events.cap = nevents;
+            ctx->events.items = (shop_event_t *) realloc(ctx->events.items, nevents*sizeof(shop_event_t));
+            SHOP_ASSERT(ctx->events.items, "out of memory");
+        }
+        ctx->events.len = nevents;
+    }
+
+    shop__exec(NULL, shop__chunk_place, chunks, (size_t) n);
+
+    for (int t = 0; t < n; t++) free(chunks[t].occs.items);
+    free(values);
+    free(counts);
+    free(chunks);
+}
+#endif
+
+SHOPDEF void shop_lazy(bool on) {
+    shop__ctx->lazy.on = on;
+}
+
+SHOPDEF void shop_track(int argc, char **argv) {
+    shop__load_defs();
+    shop__ctx->events.len = 0;
+
+    bool lazy = shop__ctx->lazy.on;
+    for (size_t i = 0; lazy && i < shop__ctx->options.len; i++) {
+        if (shop__ctx->options.items[i].bind) lazy = false;
+    }
+    if (lazy) {
+        for (size_t i = 0; i < shop__ctx->options.len; i++) {
+            shop_option_t *opt = &shop__ctx->options.items[i];
+            if (!opt->layers) continue;
+            opt->layers->src[SHOP_SRC_ARGV].len = 0;
+            opt->layers->src[SHOP_SRC_ARGV].count = 0;
+        }
+        shop__ctx->lazy.pending = true;
+        shop__ctx->lazy.argc = argc;
+        shop__ctx->lazy.argv = argv;
+        shop__ctx->lazy.next = 1;
+        return;
+    }
+
+#ifdef SHOP__HAS_THREADS
+    int n = shop__ctx->threads < 64 ? shop__ctx->threads : 64;
+    if (n > (argc - 1)/SHOP_CHUNK) n = (argc - 1)/SHOP_CHUNK;
+    if (n > 1 && !shop__ctx->subcmds) {
+        shop__track_parallel(argc, argv, n);
+        shop__track_end();
+        return;
+    }
+#endif
+    shop__track_scan(argc, argv, 1, NULL);
+    shop__track_end();
+}
+
+#ifdef SHOP_HAS_WATCH
+struct shop__watch {
+    const char *path;
+    const char *section;
+    void (*setup)(void);
+    int argc;
+    char **argv;
+    char *dir;           // the watched directory
+    const char *base;    // the file name in 'dir'
+    int fd;              // inotify
+    int stop[2];         // pipe, wakes the thread up to stop
+    pthread_t thread;
+    shop_ctx_t *current; // the published snapshot
+    unsigned epoch;      // one per publish
+    size_t readers[2];   // pins by epoch parity
+};
+
+static struct shop__watch *shop__watch;
+static SHOP__TLS unsigned shop__pin; // epoch of the pin of this thread
+
+// shop__watch_check - convert the values 'shop_track' leaves to the getters
+static void shop__watch_check(void) {
+    for (size_t i = 0; i < shop__ctx->options.len; i++) {
+        const shop_option_t *opt = &shop__ctx->options.items[i];
+        if (opt->type < SHOP_STR || opt->type > SHOP_DOUBLE) continue;
+        for (size_t j = 0; j < opt->len; j++) {
+            union { const char *s; long l; double d; } tmp;
+            SHOP_ASSERT(shop__scan(opt, opt->items[j], &tmp),
+                        "invalid value '%s' for option '-%c'", opt->items[j], opt->name);
+        }
+    }
+}
+
+// shop__watch_try - run the steps of a build in the current context
+// Note: kept out of line, so no local of the caller lives across 'setjmp'
+// Return: false if the file can not be read or a step fails
+__attribute__((noinline)) static bool shop__watch_try(const struct shop__watch *w) {
+    volatile bool ok = false;
+    jmp_buf recover;
+    shop__recover = &recover;
+    if (setjmp(recover) == 0) {
+        w->setup();
+        if (shop_load_file(w->path, w->section)) {
+            shop_track(w->argc, w->argv);
+            // readers only read, nothing may be left to scan
+            shop__lazy_finish();
+            shop__watch_check();
+            ok = true;
+        } else {
+            fprintf(stderr, "ERROR: can not read '%s'\n", w->path);
+        }
+    }
+    shop__recover = NULL;
+    return ok;
+}
+
+// shop__watch_build - build a snapshot in a fresh context
+// Return: NULL if the build fails
+static shop_ctx_t *shop__watch_build(const struct shop__watch *w) {
+    shop_ctx_t *ctx = (shop_ctx_t *) calloc(1, sizeof(*ctx));
+    if (!ctx) return NULL;
+    shop_ctx_t *prev = shop_switch(ctx);
+    bool ok = shop__watch_try(w);
+    shop_switch(prev);
+    if (ok) return ctx;
+    shop__drop(ctx);
+    return NULL;
+}
+
+// shop__watch_publish - swap the snapshot in, free the old one after a grace period
+// Note: a reader pins the epoch before it loads the pointer, so once the
+//       pins of the epoch before the swap are gone, nobody holds 'old'
+static void shop__watch_publish(struct shop__watch *w, shop_ctx_t *ctx) {
+    shop_ctx_t *old = __atomic_exchange_n(&w->current, ctx, __ATOMIC_SEQ_CST);
+    unsigned e = __atomic_fetch_add(&w->epoch, 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&w->readers[e & 1], __ATOMIC_SEQ_CST) > 0) poll(NULL, 0, 1);
+    shop__drop(old);
+}
+
+static void *shop__watch_run(void *arg) {
+    struct shop__watch *w = (struct shop__watch *) arg;
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    struct pollfd fds[2] = {{w->fd, POLLIN, 0}, {w->stop[0], POLLIN, 0}};
+    for (;;) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (fds[1].revents) break;
+        ssize_t n = read(w->fd, buf, sizeof(buf));
+        bool changed = false;
+        for (ssize_t i = 0; i < n; ) {
+            const struct inotify_event *ev = (const struct inotify_event *) (buf + i);
+            if (ev->len > 0 && strcmp(ev->name, w->base) == 0) changed = true;
+            i += sizeof(*ev) + ev->len;
+        }
+        if (!changed) continue;
+        shop_ctx_t *ctx = shop__watch_build(w);
+        if (ctx) shop__watch_publish(w, ctx);
+        else fprintf(stderr, "ERROR: reload of '%s' failed, the previous options stay\n", w->path);
+    }
+    return NULL;
+}
+
+SHOPDEF bool shop_watch(const char *path, const char *section, void (*setup)(void), int argc, char **argv) {
+    if (shop__watch) return false;
+    struct shop__watch *w = (struct shop__watch *) calloc(1, sizeof(*w));
+    SHOP_ASSERT(w, "out of memory");
+    w->path = path;
+    w->section = section;
+    w->setup = setup;
+    w->argc = argc;
+    w->argv = argv;
+    w->current = shop__watch_build(w);
+    if (!w->current) {
+        free(w);
+        return false;
+    }
+
+    // watch the directory, editors replace the file by a rename
+    w->dir = (char *) malloc(strlen(path) + 2);
+    SHOP_ASSERT(w->dir, "out of memory");
+    const char *slash = strrchr(path, '/');
+    if (slash) {
+        size_t len = (size_t) (slash - path) + 1;
+        memcpy(w->dir, path, len);
+        w->dir[len] = '\0';
+        w->base = slash + 1;
+    } else {
+        strcpy(w->dir, ".");
+        w->base = path;
+    }
+    w->fd = inotify_init1(IN_CLOEXEC);
+    SHOP_ASSERT(w->fd >= 0 && inotify_add_watch(w->fd, w->dir, IN_CLOSE_WRITE | IN_MOVED_TO) >= 0,
+                "can not watch '%s'", path);
+    SHOP_ASSERT(pipe(w->stop) == 0, "can not watch '%s'", path);
+    SHOP_ASSERT(pthread_create(&w->thread, NULL, shop__watch_run, w) == 0, "can not watch '%s'", path);
+    shop__watch = w;
+    return true;
+}
+
+SHOPDEF shop_ctx_t *shop_acquire(void) {
+    struct shop__watch *w = shop__watch;
+    SHOP_ASSERT(w, "no file is watched");
+    // a publish between the two loads may already wait for the old epoch
+    unsigned e;
+    for (;;) {
+        e = __atomic_load_n(&w->epoch, __ATOMIC_SEQ_CST);
+        __atomic_fetch_add(&w->readers[e & 1], 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&w->epoch, __ATOMIC_SEQ_CST) == e) break;
+        __atomic_fetch_sub(&w->readers[e & 1], 1, __ATOMIC_SEQ_CST);
+    }
+    shop__pin = e;
+    return shop_switch(__atomic_load_n(&w->current, __ATOMIC_SEQ_CST));
+}
+
+SHOPDEF void shop_release(shop_ctx_t *prev) {
+    shop_switch(prev);
+    __atomic_fetch_sub(&shop__watch->readers[shop__pin & 1], 1, __ATOMIC_SEQ_CST);
+}
+
+SHOPDEF void shop_unwatch(void) {
+    struct shop__watch *w = shop__watch;
+    if (!w) return;
+    SHOP_ASSERT(write(w->stop[1], "", 1) == 1, "can not stop watching '%s'", w->path);
+    pthread_join(w->thread, NULL);
+    close(w->stop[0]);
+    close(w->stop[1]);
+    close(w->fd);
+    shop__drop(w->current);
+    free(w->dir);
+    free(w);
+    shop__watch = NULL;
+}
+#endif
+
+#define SHOP__BLOB_MAGIC   0x504f4853u // "SHOP"
+#define SHOP__BLOB_VERSION 1u
+
+struct shop_blob {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t size;     // of the whole blob
+    uint32_t nopts;
+    uint8_t map[256];  // option name -> index + 1
+};
+
+// an option of a blob, the offsets are from the start of the blob
+typedef struct {
+    uint8_t name;
+    uint8_t used;
+    uint8_t type;      // of the typed slots
+    uint8_t take_arg;
+    uint32_t slot;     // size of a typed slot, 0 if none
+    uint64_t count;
+    uint64_t len;
+    uint64_t strs;     // 'len' string offsets
+    uint64_t data;     // 'len' typed slots
+} shop__blob_opt_t;
+
+static size_t shop__align8(size_t n) {
+    return (n + 7) & ~(size_t) 7;
+}
+
+static const shop__blob_opt_t *shop__blob_opts(const shop_blob_t *blob) {
+    return (const shop__blob_opt_t *) ((const char *) blob + shop__align8(sizeof(*blob)));
+}
+
+// shop__blob_write - lay the blob out, and write it if 'out' is not NULL
+// Return: the size of the blob
+static size_t shop__blob_write(char *out) {
+    const shop_ctx_t *ctx = shop__ctx;
+    size_t nopts = ctx->options.len;
+    size_t off = shop__align8(sizeof(shop_blob_t)) + nopts*sizeof(shop__blob_opt_t);
+
+    // the tables of each option, then all the strings
+    size_t strs = off;
+    for (size_t i = 0; i < nopts; i++) {
+        const shop_option_t *opt = &ctx->options.items[i];
+        strs += opt->len*sizeof(uint64_t);
+        if (opt->data) strs += shop__align8(opt->len*shop__types[opt->type].size);
+    }
+    if (!out) {
+        for (size_t i = 0; i < nopts; i++) {
+            const shop_option_t *opt = &ctx->options.items[i];
+            for (size_t j = 0; j < opt->len; j++) strs += strlen(opt->items[j]) + 1;
+        }
+        return shop__align8(strs);
+    }
+
+    shop_blob_t *blob = (shop_blob_t *) out;
+    shop__blob_opt_t *bopts = (shop__blob_opt_t *) (out + shop__align8(sizeof(shop_blob_t)));
+    memset(blob, 0, sizeof(*blob));
+    blob->magic = SHOP__BLOB_MAGIC;
+    blob->version = SHOP__BLOB_VERSION;
+    blob->nopts = (uint32_t) nopts;
+    memcpy(blob->map, ctx->map, sizeof(blob->map));
+
+    for (size_t i = 0; i < nopts; i++) {
+        const shop_option_t *opt = &ctx->options.items[i];
+        shop__blob_opt_t *b = &bopts[i];
+        memset(b, 0, sizeof(*b));
+        b->name = opt->name;
+        b->used = opt->used;
+        b->take_arg = opt->take_arg;
+        b->type = (uint8_t) opt->type;
+        b->count = opt->count;
+        b->len = opt->len;
+        b->strs = off;
+        uint64_t *offs = (uint64_t *) (out + off);
+        off += opt->len*sizeof(uint64_t);
+        for (size_t j = 0; j < opt->len; j++) {
+            size_t len = strlen(opt->items[j]) + 1;
+            memcpy(out + strs, opt->items[j], len);
+            offs[j] = strs;
+            strs += len;
+        }
+        if (opt->data) {
+            size_t size = shop__types[opt->type].size;
+            b->slot = (uint32_t) size;
+            b->data = off;
+            memcpy(out + off, opt->data, opt->len*size);
+            off += shop__align8(opt->len*size);
+        }
+    }
+    memset(out + strs, 0, shop__align8(strs) - strs);
+    blob->size = shop__align8(strs);
+    return blob->size;
+}
+
+SHOPDEF size_t shop_serialize(void *buf, size_t size) {
+    shop__lazy_finish();
+    size_t need = shop__blob_write(NULL);
+    if (buf && size >= need) shop__blob_write((char *) buf);
+    return need;
+}
+
+SHOPDEF bool shop_serialize_fd(int fd) {
+#ifdef SHOP__HAS_MMAP
+    size_t size = shop_serialize(NULL, 0);
+    void *buf = malloc(size);
+    SHOP_ASSERT(buf, "out of memory");
+    shop_serialize(buf, size);
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = write(fd, (char *) buf + done, size - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        done += (size_t) n;
+    }
+    free(buf);
+    return done == size;
+#else
+    (void) fd;
+    return false;
+#endif
+}
+
+SHOPDEF const shop_blob_t *shop_attach(const void *blob, size_t size) {
+    const shop_blob_t *b = (const shop_blob_t *) blob;
+    if (!b || ((uintptr_t) blob & 7) != 0 || size < sizeof(*b)) return NULL;
+    if (b->magic != SHOP__BLOB_MAGIC || b->version != SHOP__BLOB_VERSION) return NULL;
+    if (b->size > size || b->nopts > 256) return NULL;
+
+    size_t end = shop__align8(sizeof(*b)) + b->nopts*sizeof(shop__blob_opt_t);
+    if (end > b->size) return NULL;
+    for (int name = 0; name < 256; name++) {
+        if (b->map[name] > b->nopts) return NULL;
+    }
+
+    // written so that no bound can wrap around
+    uint64_t total = b->size;
+    const shop__blob_opt_t *opts = shop__blob_opts(b);
+    for (uint32_t i = 0; i < b->nopts; i++) {
+        const shop__blob_opt_t *o = &opts[i];
+        if ((o->strs & 7) != 0 || o->strs > total || o->len > (total - o->strs)/sizeof(uint64_t)) return NULL;
+        if (o->slot && (o->type >= SHOP__MAX_TYPES || o->data > total || o->len > (total - o->data)/o->slot)) {
+            return NULL;
+        }
+    }
+    return b;
+}
+
+SHOPDEF const shop_blob_t *shop_attach_fd(int fd) {
+#ifdef SHOP__HAS_MMAP
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) return NULL;
+
+    // map exactly the size in the header, the length 'shop_detach' unmaps,
+    // a file longer than its blob is mapped a second time
+    size_t len = (size_t) st.st_size;
+    for (int tries = 0; tries < 2; tries++) {
+        void *addr = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED) return NULL;
+        const shop_blob_t *blob = shop_attach(addr, len);
+        if (blob && blob->size == len) return blob;
+        size_t size = blob ? (size_t) blob->size : 0;
+        munmap(addr, len);
+        if (size == 0) return NULL;
+        len = size;
+    }
+    return NULL;
+#else
+    (void) fd;
+    return NULL;
+#endif
+}
+
+SHOPDEF void shop_detach(const shop_blob_t *blob) {
+#ifdef SHOP__HAS_MMAP
+    if (blob) munmap((void *) blob, blob->size);
+#else
+    (void) blob;
+#endif
+}
+
+static const shop__blob_opt_t *shop__blob_find(const shop_blob_t *blob, unsigned char name) {
+    unsigned char idx = blob->map[name];
+    return idx ? &shop__blob_opts(blob)[idx - 1] : NULL;
+}
+
+SHOPDEF bool shop_blob_use(const shop_blob_t *blob, unsigned char name) {
+    const shop__blob_opt_t *o = shop__blob_find(blob, name);
+    return o && o->used;
+}
+
+SHOPDEF size_t shop_blob_len(const shop_blob_t *blob, unsigned char name) {
+    const shop__blob_opt_t *o = shop__blob_find(blob, name);
+    return o ? (size_t) o->len : 0;
+}
+
+SHOPDEF bool shop_blob_get(const shop_blob_t *blob, unsigned char name, size_t idx, shop_type_t type, void *dst) {
+    const shop__blob_opt_t *o = shop__blob_find(blob, name);
+    if (!o || idx >= o->len) return false;
+    const char *base = (const char *) blob;
+    const char *value = base + ((const uint64_t *) (base + o->strs))[idx];
+    if (type == SHOP_STR) {
+        *((const char **) dst) = value;
+        return true;
+    }
+    if (o->type == SHOP_CHOICE && type == SHOP_INT) type = SHOP_CHOICE;
+    if (o->slot && type == o->type && o->slot == shop__types[type].size) {
+        memcpy(dst, base + o->data + idx*o->slot, o->slot);
+        return true;
+    }
+    if (!shop__types[type].conv) return false;
+    return shop__types[type].conv(value, dst);
+}
+
+// arguments of 'shop_build_argv', only counted while 'argv' is NULL
+typedef struct {
+    char **argv;
+    char *bytes;
+    size_t argc;
+    size_t nbytes;
+} shop__argv_t;
+
+// shop__argv_push - add '-<name><value>', or '<value>' if 'name' is 0
+static void shop__argv_push(shop__argv_t *a, unsigned char name, const char *value) {
+    size_t len = value ? strlen(value) : 0;
+    if (a->argv) {
+        char *p = a->bytes + a->nbytes;
+        a->argv[a->argc] = p;
+        if (name) {
+            *p++ = '-';
+            *p++ = (char) name;
+        }
+        if (len > 0) memcpy(p, value, len);
+        p[len] = '\0';
+    }
+    a->argc++;
+    a->nbytes += (name ? 2 : 0) + len + 1;
+}
+
+// shop__argv_value - add an occurrence of the option
+static void shop__argv_value(shop__argv_t *a, const shop_option_t *opt, const char *value) {
+    if (!opt->take_arg) {
+        shop__argv_push(a, opt->name, NULL);
+    } else if (!value || value[0] == '\0') {
+        // '-n' alone takes the next argument
+        shop__argv_push(a, opt->name, NULL);
+        shop__argv_push(a, 0, "");
+    } else {
+        shop__argv_push(a, opt->name, value);
+    }
+}
+
+static void shop__argv_ctx(shop__argv_t *a, const shop_ctx_t *ctx, const shop_override_t *overrides) {
+    for (const shop_override_t *o = overrides; o && o->name; o++) {
+        SHOP_ASSERT(ctx->map[o->name], "unknown option: '-%c'", o->name);
+    }
+
+    for (size_t i = 0; i < ctx->options.len; i++) {
+        const shop_option_t *opt = &ctx->options.items[i];
+        bool replaced = false;
+        for (const shop_override_t *o = overrides; o && o->name; o++) {
+            if (o->name != opt->name) continue;
+            replaced = true;
+            if (o->value) shop__argv_value(a, opt, o->value);
+        }
+        if (replaced || !opt->used) continue;
+
+        if (!opt->take_arg || opt->mode == SHOP_COUNT) {
+            size_t times = opt->mode == SHOP_COUNT ? opt->count : 1;
+            for (size_t j = 0; j < times; j++) shop__argv_value(a, opt, NULL);
+        } else {
+            for (size_t j = 0; j < opt->len; j++) shop__argv_value(a, opt, opt->items[j]);
+        }
+    }
+
+    const struct shop__subcmds *s = ctx->subcmds;
+    if (s && s->child) {
+        shop__argv_push(a, 0, s->selected);
+        shop__argv_ctx(a, s->child, NULL);
+    }
+}
+
+SHOPDEF size_t shop_build_argv_buf(shop_ctx_t *ctx, const char *prog, const shop_override_t *overrides,
+                                   void *buf, size_t size, char ***argv_out) {
+    if (!ctx) ctx = shop__ctx;
+    shop_ctx_t *prev = shop_switch(ctx);
+    shop__lazy_finish();
+    shop_switch(prev);
+    shop__argv_t a = { NULL, NULL, 0, 0 };
+    shop__argv_push(&a, 0, prog);
+    shop__argv_ctx(&a, ctx, overrides);
+    size_t need = (a.argc + 1)*sizeof(char *) + a.nbytes;
+    *argv_out = NULL;
+    if (!buf || size < need) return need;
+
+    a.argv = (char **) buf;
+    a.bytes = (char *) buf + (a.argc + 1)*sizeof(char *);
+    a.argc = 0;
+    a.nbytes = 0;
+    shop__argv_push(&a, 0, prog);
+    shop__argv_ctx(&a, ctx, overrides);
+    a.argv[a.argc] = NULL;
+    *argv_out = a.argv;
+    return need;
+}
+
+SHOPDEF size_t shop_build_argv(shop_ctx_t *ctx, const char *prog, const shop_override_t *overrides, char ***argv_out) {
+    size_t size = shop_build_argv_buf(ctx, prog, overrides, NULL, 0, argv_out);
+    void *buf = malloc(size);
+    SHOP_ASSERT(buf, "out of memory");
+    shop_build_argv_buf(ctx, prog, overrides, buf, size, argv_out);
+    size_t argc = 0;
+    while ((*argv_out)[argc]) argc++;
+    return argc;
+}
+
+// state of 'shop_fingerprint', the rounds of MurmurHash3 x64 128, one lane per word
+typedef struct {
+    uint64_t h1, h2;
+    uint64_t n;
+} shop__fp_t;
+
+static uint64_t shop__rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static uint64_t shop__fmix64(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+static void shop__fp_word(shop__fp_t *fp, uint64_t k) {
+    const uint64_t c1 = 0x87c37b91114253d5ULL;
+    const uint64_t c2 = 0x4cf5ad432745937fULL;
+    if (fp->n++ & 1) {
+        k *= c2; k = shop__rotl64(k, 33); k *= c1; fp->h2 ^= k;
+        fp->h2 = shop__rotl64(fp->h2, 31); fp->h2 += fp->h1; fp->h2 = fp->h2*5 + 0x38495ab5;
+    } else {
+        k *= c1; k = shop__rotl64(k, 31); k *= c2; fp->h1 ^= k;
+        fp->h1 = shop__rotl64(fp->h1, 27); fp->h1 += fp->h2; fp->h1 = fp->h1*5 + 0x52dce729;
+    }
+}
+
+static void shop__fp_bytes(shop__fp_t *fp, const void *p, size_t len) {
+    shop__fp_word(fp, len);
+    for (size_t i = 0; i < len; i += 8) {
+        uint64_t k = 0;
+        memcpy(&k, (const char *) p + i, len - i < 8 ? len - i : 8);
+        shop__fp_word(fp, k);
+    }
+}
+
+// shop__fp_value - hash a value converted by the type of the option
+static void shop__fp_value(shop__fp_t *fp, const shop_option_t *opt, size_t idx) {
+    shop_type_t type = opt->type;
+    if (opt->data && type < SHOP_USER) {
+        size_t size = shop__types[type].size;
+        shop__fp_bytes(fp, opt->data + idx*size, size);
+        return;
+    }
+    if (type >= SHOP_BOOL && type <= SHOP_DOUBLE) {
+        // zeroed, so only the bytes of the value count
+        union { bool b; int i; long l; float f; double d; } v;
+        memset(&v, 0, sizeof(v));
+        if (shop__types[type].conv(opt->items[idx], &v)) {
+            shop__fp_bytes(fp, &v, sizeof(v));
+            return;
+        }
+    }
+    shop__fp_bytes(fp, opt->items[idx], strlen(opt->items[idx]));
+}
+
+static int shop__pair_cmp(const void *a, const void *b) {
+    const shop__pair_t *x = *(const shop__pair_t *const *) a;
+    const shop__pair_t *y = *(const shop__pair_t *const *) b;
+    int c = memcmp(x->key, y->key, x->klen < y->klen ? x->klen : y->klen);
+    if (c != 0) return c;
+    return (x->klen > y->klen) - (x->klen < y->klen);
+}
+
+// shop__fp_dict - hash the distinct keys with the values 'shop_dict_get'
+// returns, sorted by key, so the order of the pairs does not count
+static void shop__fp_dict(shop__fp_t *fp, const struct shop__dict *d) {
+    shop__fp_word(fp, d->index.keys);
+    if (d->index.keys == 0) return;
+    const shop__pair_t **pairs = (const shop__pair_t **) malloc(d->index.keys*sizeof(*pairs));
+    SHOP_ASSERT(pairs, "out of memory");
+    size_t n = 0;
+    for (size_t i = 0; i <= d->index.mask; i++) {
+        if (d->index.slots[i]) pairs[n++] = &d->items[d->index.slots[i] - 1];
+    }
+    qsort((void *) pairs, n, sizeof(*pairs), shop__pair_cmp);
+    for (size_t i = 0; i < n; i++) {
+        shop__fp_bytes(fp, pairs[i]->key, pairs[i]->klen);
+        shop__fp_bytes(fp, pairs[i]->val, pairs[i]->vlen);
+    }
+    free((void *) pairs);
+}
+
+static void shop__fp_ctx(shop__fp_t *fp, const shop_ctx_t *ctx) {
+    for (int name = 0; name < 256; name++) {
+        if (!ctx->map[name]) continue;
+        const shop_option_t *opt = &ctx->options.items[ctx->map[name] - 1];
+        if (!opt->used && !opt->is_default) continue;
+
+        shop__fp_word(fp, (uint64_t) name);
+        if (!opt->take_arg || opt->mode == SHOP_COUNT) {
+            shop__fp_word(fp, opt->mode == SHOP_COUNT ? opt->count : 1);
+        } else if (opt->ranges) {
+            const struct shop__ranges *r = opt->ranges;
+            for (size_t i = 0; i < r->len; ) {
+                long lo = r->items[i].lo, hi = r->items[i].hi;
+                for (i++; i < r->len && hi < LONG_MAX && r->items[i].lo == hi + 1; i++) hi = r->items[i].hi;
+                shop__fp_word(fp, (uint64_t) lo);
+                shop__fp_word(fp, (uint64_t) hi);
+            }
+        } else if (opt->dict) {
+            shop__fp_dict(fp, opt->dict);
+        } else {
+            shop__fp_word(fp, opt->len);
+            for (size_t i = 0; i < opt->len; i++) shop__fp_value(fp, opt, i);
+        }
+    }
+
+    const struct shop__subcmds *s = ctx->subcmds;
+    if (s && s->child) {
+        shop__fp_word(fp, 256);
+        shop__fp_bytes(fp, s->selected, strlen(s->selected));
+        shop__fp_ctx(fp, s->child);
+    }
+}
+
+SHOPDEF shop_fingerprint_t shop_fingerprint(void) {
+    shop__lazy_finish();
+    shop__fp_t fp = { 0, 0, 0 };
+    shop__fp_ctx(&fp, shop__ctx);
+    uint64_t h1 = fp.h1 ^ fp.n*8, h2 = fp.h2 ^ fp.n*8;
+    h1 += h2;
+    h2 += h1;
+    h1 = shop__fmix64(h1);
+    h2 = shop__fmix64(h2);
+    h1 += h2;
+    h2 += h1;
+    shop_fingerprint_t res = { h1, h2 };
+    return res;
+}
+
+SHOPDEF void shop_verbose(void) {
+    shop__load_defs();
+    shop__lazy_finish();
+    const int DESC_WIDTH = 20;
+    const int ARG_WIDTH = 10;
+
+    printf("\n%-6s  %-*s  %-6s  %-10s  %-*s\n",
+           "Option", DESC_WIDTH, "Description", "Used", "Type", ARG_WIDTH, "Argument");
+    printf("%-6s  %-*s  %-6s  %-10s  %-*s\n",
+           "------", DESC_WIDTH, "-----------", "----", "----", ARG_WIDTH, "--------");
+
+    for (size_t i = 0; i < shop__ctx->options.len; i++) {
+        const shop_option_t *opt_ptr = &shop__ctx->options.items[i];
+
+        char short_desc[DESC_WIDTH + 4];
+        const char *desc = opt_ptr->info ? opt_ptr->info : "";
+        if (strlen(desc) > (size_t) DESC_WIDTH) {
+            strncpy(short_desc, desc, DESC_WIDTH - 3);
+            short_desc[DESC_WIDTH - 3] = '\0';
+            strcat(short_desc, "...");
+        } else {
+            strcpy(short_desc, desc);
+        }
+        printf("-%c      %-*s  %-6s  %-10s  ",
+               opt_ptr->name,
+               DESC_WIDTH, short_desc,
+               opt_ptr->used ? "yes" : opt_ptr->is_default ? "def" : "no",
                opt_ptr->take_arg ? "with-arg" : "flag");
 
         char short_arg[ARG_WIDTH + 4];
@@ -312,41 +3116,218 @@ SHOPDEF void shop_verbose(void) {
 }
 
 SHOPDEF void shop_help(void) {
-    for (size_t i = 0; i < shop__options.len; i++) {
-        const shop_option_t *opt_ptr = &shop__options.items[i];
-        printf("%c -%c    %s\n", opt_ptr->take_arg ? '*' : ' ', opt_ptr->name, opt_ptr->info);
+    shop__load_defs();
+    for (size_t i = 0; i < shop__ctx->options.len; i++) {
+        const shop_option_t *opt_ptr = &shop__ctx->options.items[i];
+        printf("%c -%c    %s", opt_ptr->take_arg ? '*' : ' ', opt_ptr->name, opt_ptr->info);
+        if (opt_ptr->def) printf(" (default: %s)", opt_ptr->def);
+        printf("\n");
+    }
+    const struct shop__subcmds *s = shop__ctx->subcmds;
+    for (size_t i = 0; s && i < s->len; i++) {
+        printf("  %-10s %s\n", s->items[i].name, s->items[i].info ? s->items[i].info : "");
     }
 }
 
 SHOPDEF size_t shop_len(unsigned char name) {
-    const shop_option_t *opt_ptr = shop__find(name);
-    return opt_ptr->len;
+    const shop_option_t *opt_ptr = shop__query(name);
+    return shop__count(opt_ptr);
+}
+
+SHOPDEF const char *shop_dict_get(unsigned char name, const char *key, size_t *len) {
+    const shop_option_t *opt_ptr = shop__query(name);
+    if (!opt_ptr || !opt_ptr->dict) return NULL;
+
+    const struct shop__dict *d = opt_ptr->dict;
+    uint32_t i = shop__index_find(d, key, strlen(key));
+    if (i == 0) return NULL;
+    if (len) *len = d->items[i-1].vlen;
+    return d->items[i-1].val;
+}
+
+SHOPDEF bool shop_get_bitmap(unsigned char name, uint64_t *bits, size_t nbits) {
+    const shop_option_t *opt_ptr = shop__query(name);
+    if (!opt_ptr || opt_ptr->type != SHOP_RANGE) return false;
+
+    memset(bits, 0, (nbits + 63)/64*sizeof(uint64_t));
+    if (!opt_ptr->ranges) return true;
+
+    bool fit = true;
+    for (size_t i = 0; i < opt_ptr->ranges->len; i++) {
+        size_t lo = (size_t) opt_ptr->ranges->items[i].lo;
+        size_t hi = (size_t) opt_ptr->ranges->items[i].hi;
+        if (hi >= nbits) {
+            fit = false;
+            if (lo >= nbits) continue;
+            hi = nbits - 1;
+        }
+
+        size_t lw = lo/64, hw = hi/64;
+        uint64_t lmask = ~0ull << (lo%64);
+        uint64_t hmask = ~0ull >> (63 - hi%64);
+        if (lw == hw) {
+            bits[lw] |= lmask & hmask;
+            continue;
+        }
+        bits[lw] |= lmask;
+        for (size_t w = lw + 1; w < hw; w++) bits[w] = ~0ull;
+        bits[hw] |= hmask;
+    }
+    return fit;
 }
 
 SHOPDEF bool shop_sget(unsigned char name, size_t idx, void *dst) {
-    const shop_option_t *opt_ptr = shop__find(name);
-    if (!opt_ptr || !opt_ptr->used || !opt_ptr->take_arg
-     || !opt_ptr->scan_fmt || opt_ptr->scan_fmt[0] == '\0'
-     || idx >= opt_ptr->len) {
+    const shop_option_t *opt_ptr = shop__query(name);
+    if (!opt_ptr || !(opt_ptr->used || opt_ptr->is_default) || !opt_ptr->take_arg
+     || opt_ptr->type == SHOP_NONE || idx >= shop__count(opt_ptr)) {
         return false;
     }
 
-    const char *value = opt_ptr->items[idx];
-    const char *scan_fmt = opt_ptr->scan_fmt;
+    return shop__value(opt_ptr, idx, shop__scan_type(opt_ptr), dst);
+}
 
-    if (strcmp(scan_fmt, "%s") == 0) {
-        *((const char**) dst) = value;
-    } else if (strcmp(scan_fmt, "%b") == 0) {
-        bool res = (strcmp(value, "true") == 0 ||
-                    strcmp(value, "yes") == 0 ||
-                    strcmp(value, "1") == 0 ||
-                    strcmp(value, "on") == 0);
-        memcpy(dst, &res, sizeof(bool));
-    } else {
-        if (sscanf(value, scan_fmt, dst) != 1) return false;
+// shop__get - get the value through the converter of 'type'
+static bool shop__get(unsigned char name, size_t idx, shop_type_t type, void *dst) {
+    const shop_option_t *opt_ptr = shop__query(name);
+    if (!opt_ptr || !opt_ptr->take_arg || idx >= shop__count(opt_ptr)) return false;
+    return shop__value(opt_ptr, idx, type, dst);
+}
+
+SHOPDEF bool shop_get_str(unsigned char name, size_t idx, const char **dst) {
+    return shop__get(name, idx, SHOP_STR, (void *) dst);
+}
+
+SHOPDEF bool shop_get_bool(unsigned char name, size_t idx, bool *dst) {
+    return shop__get(name, idx, SHOP_BOOL, dst);
+}
+
+SHOPDEF bool shop_get_int(unsigned char name, size_t idx, int *dst) {
+    return shop__get(name, idx, SHOP_INT, dst);
+}
+
+SHOPDEF bool shop_get_long(unsigned char name, size_t idx, long *dst) {
+    return shop__get(name, idx, SHOP_LONG, dst);
+}
+
+SHOPDEF bool shop_get_float(unsigned char name, size_t idx, float *dst) {
+    return shop__get(name, idx, SHOP_FLOAT, dst);
+}
+
+SHOPDEF bool shop_get_double(unsigned char name, size_t idx, double *dst) {
+    return shop__get(name, idx, SHOP_DOUBLE, dst);
+}
+
+SHOPDEF shop_iter_t shop_iter(unsigned char name, shop_type_t type) {
+    shop_iter_t it;
+    memset(&it, 0, sizeof(it));
+
+    const shop_option_t *opt_ptr = shop__query(name);
+    if (!opt_ptr || !opt_ptr->take_arg) return it;
+    if (type == SHOP_NONE) {
+        // the same checks as 'shop_sget'
+        if (!(opt_ptr->used || opt_ptr->is_default) || opt_ptr->type == SHOP_NONE) return it;
+        type = shop__scan_type(opt_ptr);
     }
 
-    return true;
+    it.opt = opt_ptr;
+    it.type = type;
+    it.len = shop__count(opt_ptr);
+    return it;
+}
+
+SHOPDEF bool shop_next(shop_iter_t *it, void *dst) {
+    if (it->idx >= it->len) return false;
+    return shop__value(it->opt, it->idx++, it->type, dst);
+}
+
+SHOPDEF size_t shop_export(unsigned char name, shop_type_t type, void *out, size_t n) {
+    const shop_option_t *opt_ptr = shop__query(name);
+    if (!opt_ptr || !opt_ptr->take_arg || type < SHOP_STR || (size_t) type >= shop__ntypes) return 0;
+
+    if (opt_ptr->type == SHOP_CHOICE && type == SHOP_INT) type = SHOP_CHOICE;
+    size_t size = shop__types[type].size;
+    size_t count = shop__count(opt_ptr);
+    size_t len = count < n ? count : n;
+    if (opt_ptr->data && type == opt_ptr->type) {
+        memcpy(out, opt_ptr->data, len*size);
+        return len;
+    }
+
+    unsigned char *dst = (unsigned char *) out;
+    if (opt_ptr->ranges) {
+        for (size_t i = 0; i < len; i++) {
+            if (!shop__value(opt_ptr, i, type, dst + i*size)) return i;
+        }
+        return len;
+    }
+
+    shop_parse_fn conv = shop__types[type].conv;
+    if (!conv) return 0;
+    for (size_t i = 0; i < len; i++) {
+        if (!conv(opt_ptr->items[i], dst + i*size)) return i;
+    }
+    return len;
+}
+
+// the values of 'shop_convert_all', split in tasks of 'part' values
+typedef struct {
+    const shop_option_t *opt;
+    shop_type_t type;
+    unsigned char *out;
+    bool *ok;
+    size_t len;
+    size_t part;
+    size_t *bad; // per task, number of invalid values
+} shop__convert_t;
+
+static void shop__convert_task(void *arg, size_t t) {
+    const shop__convert_t *c = (const shop__convert_t *) arg;
+    size_t size = shop__types[c->type].size;
+    size_t lo = t*c->part;
+    size_t hi = lo + c->part < c->len ? lo + c->part : c->len;
+    size_t bad = 0;
+    for (size_t i = lo; i < hi; i++) {
+        bool valid = shop__value(c->opt, i, c->type, c->out + i*size);
+        if (c->ok) c->ok[i] = valid;
+        bad += !valid;
+    }
+    c->bad[t] = bad;
+}
+
+// shop__convert - split the values in 'ntasks' tasks, or tasks of 'part' values if 0
+static size_t shop__convert(unsigned char name, shop_type_t type, void *out, size_t n, bool *ok,
+                            size_t ntasks, size_t part, shop_exec_fn exec, void *user) {
+    const shop_option_t *opt_ptr = shop__query(name);
+    if (!opt_ptr || !opt_ptr->take_arg || type < SHOP_STR || (size_t) type >= shop__ntypes) return SIZE_MAX;
+    if (opt_ptr->type == SHOP_CHOICE && type == SHOP_INT) type = SHOP_CHOICE;
+    if (!shop__types[type].conv && !(opt_ptr->data && type == opt_ptr->type) && !opt_ptr->ranges) return SIZE_MAX;
+
+    size_t count = shop__count(opt_ptr);
+    size_t len = count < n ? count : n;
+    if (len == 0) return 0;
+    if (ntasks == 0) ntasks = 1;
+    if (part == 0) part = (len + ntasks - 1)/ntasks;
+    ntasks = (len + part - 1)/part;
+
+    shop__convert_t c = { opt_ptr, type, (unsigned char *) out, ok, len, part, NULL };
+    c.bad = (size_t *) calloc(ntasks, sizeof(size_t));
+    SHOP_ASSERT(c.bad, "out of memory");
+    exec(user, shop__convert_task, &c, ntasks);
+
+    size_t bad = 0;
+    for (size_t t = 0; t < ntasks; t++) bad += c.bad[t];
+    free(c.bad);
+    return bad;
+}
+
+SHOPDEF size_t shop_convert_all(unsigned char name, shop_type_t type, void *out, size_t n, bool *ok, int nthreads) {
+    size_t ntasks = nthreads > 1 ? (size_t) nthreads : 1;
+    return shop__convert(name, type, out, n, ok, ntasks, 0, shop__exec, NULL);
+}
+
+SHOPDEF size_t shop_convert_all_with(unsigned char name, shop_type_t type, void *out, size_t n, bool *ok,
+                                     shop_exec_fn exec, void *user) {
+    return shop__convert(name, type, out, n, ok, 0, SHOP_CHUNK, exec, user);
 }
 
 #endif // SHOP_IMPLEMENTATION
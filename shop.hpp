@@ -0,0 +1,537 @@
+/*
+shop.hpp - v0.1.0 - Dylaris 2026
+===================================================
+
+BRIEF:
+  C++17 front ends of shop.h.
+  - 'shop::parser': the option string and the scan formats
+    are parsed at compile time, so option lookup is a fixed
+    slot index and only the argv scan is left at runtime.
+  - 'shop::options': a RAII wrapper over a shop.h context,
+    values are views into argv and nothing is allocated per
+    access.
+
+NOTICE:
+  Requires C++17, 'shop::options::items' requires C++20.
+
+USAGE:
+  'shop::parser' is header only. 'shop::options' uses the C
+  core, so define the implementation macro in exactly one
+  source file, like shop.h:
+  ```
+    #define SHOP_IMPLEMENTATION
+    #include "shop.hpp"
+  ```
+  The spec strings of 'shop::parser' must have static storage
+  duration.
+
+EXAMPLE:
+```cpp
+// ./main -vn 1
+static constexpr char opts[] = "vn:f:h";
+static constexpr char fmts[] = "n%d f%s";
+
+int main(int argc, char **argv) {
+    shop::parser<opts, fmts> p;
+    p.track(argc, argv);
+
+    if (p.use<'h'>()) return 0;
+
+    // 'n' resolves to its slot at compile time, and
+    // 'n' with 'double' or an undefined 'x' is a compile error
+    if (auto number = p.get<'n', int>()) {
+        printf("number: %d\n", *number);
+    }
+
+    for (std::size_t i = 0; i < p.len<'f'>(); i++) {
+        printf("file: %s\n", *p.get<'f', const char *>(i));
+    }
+    return 0;
+}
+
+// ./main -n 1 -n 2 -f data.txt
+int main(int argc, char **argv) {
+    shop::options opts("n:f:");
+    opts.desc('n', "%d", "Number (int)")
+        .desc('f', "%s", "Filename (string)");
+    opts.track(argc, argv);
+
+    std::string_view file = opts.value('f'); // points into argv
+    for (int n : opts.values<int>('n')) { ... } // converts lazily
+    return 0;
+} // no 'shop_free'
+```
+
+LICENSE:
+  Same as shop.h (MIT).
+*/
+
+#ifndef SHOP_HPP
+#define SHOP_HPP
+
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#if __cplusplus >= 202002L
+#include <ranges>
+#include <span>
+#endif
+
+#include "shop.h"
+
+namespace shop {
+
+namespace detail {
+
+constexpr bool is_sep(char c) { return c == ':' || c == ' '; }
+
+// count - number of options in the option string
+constexpr std::size_t count(const char *opt_str) {
+    std::size_t n = 0;
+    for (std::size_t i = 0; opt_str[i] != '\0'; i++) {
+        if (!is_sep(opt_str[i])) n++;
+    }
+    return n;
+}
+
+// fmt_kind - the value type of a scan format, resolved at compile time
+enum class fmt_kind { none, str, boolean, int_, long_, llong, uint, ulong, float_, double_, char_, unknown };
+
+constexpr bool eq(const char *a, std::size_t len, const char *b) {
+    std::size_t i = 0;
+    for (; i < len && b[i] != '\0'; i++) {
+        if (a[i] != b[i]) return false;
+    }
+    return i == len && b[i] == '\0';
+}
+
+constexpr fmt_kind kind_of(const char *fmt, std::size_t len) {
+    if (len == 0)          return fmt_kind::none;
+    if (eq(fmt, len, "%s"))   return fmt_kind::str;
+    if (eq(fmt, len, "%b"))   return fmt_kind::boolean;
+    if (eq(fmt, len, "%d") ||
+        eq(fmt, len, "%i"))   return fmt_kind::int_;
+    if (eq(fmt, len, "%ld"))  return fmt_kind::long_;
+    if (eq(fmt, len, "%lld")) return fmt_kind::llong;
+    if (eq(fmt, len, "%u"))   return fmt_kind::uint;
+    if (eq(fmt, len, "%lu"))  return fmt_kind::ulong;
+    if (eq(fmt, len, "%f"))   return fmt_kind::float_;
+    if (eq(fmt, len, "%lf"))  return fmt_kind::double_;
+    if (eq(fmt, len, "%c"))   return fmt_kind::char_;
+    return fmt_kind::unknown;
+}
+
+struct slot {
+    unsigned char name;
+    bool take_arg;
+    fmt_kind kind;
+};
+
+// table - the compiled form of an option string and a format string
+// @opt_str: same syntax as 'shop_set', 'n:' means 'n' takes an argument
+// @fmt_str: space separated '<name><scan_fmt>' pairs, like "n%d f%s"
+template <std::size_t N>
+struct table {
+    std::array<slot, N> slots{};
+    std::array<unsigned char, 256> map{}; // name -> slot index + 1
+    bool dup = false;     // an option is defined twice
+    bool bad_fmt = false; // a format names an undefined option or is unsupported
+    bool fmt_no_arg = false; // a format is given to an option without argument
+};
+
+template <std::size_t N>
+constexpr table<N> compile(const char *opt_str, const char *fmt_str) {
+    table<N> t{};
+    std::size_t n = 0;
+    std::size_t i = 0;
+    // same rule as 'shop_set': the last option of a token takes argument,
+    // the last token only if the string ends with ':'
+    for (; opt_str[i] != '\0'; i++) {
+        char c = opt_str[i];
+        if (is_sep(c)) continue;
+        unsigned char name = static_cast<unsigned char>(c);
+        if (t.map[name] != 0) t.dup = true;
+        bool take_arg = opt_str[i+1] == '\0' || is_sep(opt_str[i+1]);
+        t.slots[n] = slot{name, take_arg, fmt_kind::none};
+        t.map[name] = static_cast<unsigned char>(n + 1);
+        n++;
+    }
+    if (n > 0 && opt_str[i-1] != ':') t.slots[n-1].take_arg = false;
+
+    for (std::size_t i = 0; fmt_str[i] != '\0';) {
+        if (fmt_str[i] == ' ') { i++; continue; }
+        unsigned char name = static_cast<unsigned char>(fmt_str[i++]);
+        std::size_t start = i;
+        while (fmt_str[i] != '\0' && fmt_str[i] != ' ') i++;
+        fmt_kind kind = kind_of(fmt_str + start, i - start);
+        if (t.map[name] == 0 || kind == fmt_kind::unknown || kind == fmt_kind::none) {
+            t.bad_fmt = true;
+            continue;
+        }
+        slot &s = t.slots[t.map[name] - 1];
+        if (!s.take_arg) t.fmt_no_arg = true;
+        s.kind = kind;
+    }
+    return t;
+}
+
+// accepts - whether 'T' is a valid destination for a format
+template <typename T>
+constexpr bool accepts(fmt_kind kind) {
+    switch (kind) {
+    case fmt_kind::str:     return std::is_same_v<T, const char *> || std::is_same_v<T, std::string_view>;
+    case fmt_kind::boolean: return std::is_same_v<T, bool>;
+    case fmt_kind::int_:    return std::is_same_v<T, int>;
+    case fmt_kind::long_:   return std::is_same_v<T, long>;
+    case fmt_kind::llong:   return std::is_same_v<T, long long>;
+    case fmt_kind::uint:    return std::is_same_v<T, unsigned int>;
+    case fmt_kind::ulong:   return std::is_same_v<T, unsigned long>;
+    case fmt_kind::float_:  return std::is_same_v<T, float>;
+    case fmt_kind::double_: return std::is_same_v<T, double>;
+    case fmt_kind::char_:   return std::is_same_v<T, char>;
+    default:                return false;
+    }
+}
+
+// convert - runtime conversion of one value, the format is already checked
+template <typename T>
+bool convert(const char *value, T &dst) {
+    if constexpr (std::is_same_v<T, const char *>) {
+        dst = value;
+        return true;
+    } else if constexpr (std::is_same_v<T, std::string_view>) {
+        dst = value;
+        return true;
+    } else if constexpr (std::is_same_v<T, bool>) {
+        dst = std::strcmp(value, "true") == 0 ||
+              std::strcmp(value, "yes") == 0 ||
+              std::strcmp(value, "1") == 0 ||
+              std::strcmp(value, "on") == 0;
+        return true;
+    } else if constexpr (std::is_same_v<T, char>) {
+        if (value[0] == '\0') return false;
+        dst = value[0];
+        return true;
+    } else {
+        // behave like sscanf: skip leading spaces, allow '+' and a trailing rest
+        while (*value == ' ' || *value == '\t' || *value == '\n') value++;
+        if (*value == '+') value++;
+        const char *end = value + std::strlen(value);
+        auto res = std::from_chars(value, end, dst);
+        return res.ec == std::errc();
+    }
+}
+
+} // namespace detail
+
+// parser - compile-time option table, runtime argv scan
+// @OptStr: predefined option string, see 'shop_set'
+// @FmtStr: scan formats of options, like "n%d f%s b%b p%f"
+template <const char *OptStr, const char *FmtStr = nullptr>
+class parser {
+    static constexpr const char *fmt_str = FmtStr ? FmtStr : "";
+    static constexpr std::size_t N = detail::count(OptStr);
+    static constexpr detail::table<N> tab = detail::compile<N>(OptStr, fmt_str);
+
+    static_assert(N > 0, "empty option string");
+    static_assert(!tab.dup, "option defined more than once");
+    static_assert(!tab.bad_fmt, "format of an undefined option, or an unsupported format");
+    static_assert(!tab.fmt_no_arg, "format given to an option without argument");
+
+    template <unsigned char Name>
+    static constexpr std::size_t slot_of() {
+        constexpr std::size_t idx = tab.map[Name];
+        static_assert(idx != 0, "unknown option");
+        return idx - 1;
+    }
+
+    struct state {
+        bool used = false;
+        std::vector<const char *> items;
+    };
+    std::array<state, N> states_{};
+
+public:
+    // track - track the cmdline arguments, same rules as 'shop_track'
+    void track(int argc, char **argv) {
+        for (int i = 1; i < argc; i++) {
+            const char *arg = argv[i];
+            if (arg[0] != '-') continue;
+
+            for (int j = 1; arg[j] != '\0'; j++) {
+                unsigned char name = static_cast<unsigned char>(arg[j]);
+                std::size_t idx = tab.map[name];
+                if (idx == 0) {
+                    std::fprintf(stderr, "ERROR: unknown option: '-%c'\n", arg[j]);
+                    std::exit(EXIT_FAILURE);
+                }
+                state &st = states_[idx - 1];
+                st.used = true;
+                if (!tab.slots[idx - 1].take_arg) continue;
+
+                if (arg[j+1] != '\0') {
+                    st.items.push_back(arg + j + 1);
+                } else {
+                    if (++i >= argc) {
+                        std::fprintf(stderr, "ERROR: option '%s' require argument but not supply\n", arg);
+                        std::exit(EXIT_FAILURE);
+                    }
+                    st.items.push_back(argv[i]);
+                }
+                break;
+            }
+        }
+    }
+
+    // use - check if the option is used
+    template <unsigned char Name>
+    bool use() const {
+        return states_[slot_of<Name>()].used;
+    }
+
+    // len - get the length of option value array
+    template <unsigned char Name>
+    std::size_t len() const {
+        return states_[slot_of<Name>()].items.size();
+    }
+
+    // get - get the option value converted to 'T'
+    // Note: 'T' must match the option's scan format, checked at compile time
+    // Return: the value, or nothing if absent or not convertible
+    template <unsigned char Name, typename T>
+    std::optional<T> get(std::size_t idx = 0) const {
+        constexpr std::size_t s = slot_of<Name>();
+        static_assert(tab.slots[s].take_arg, "option takes no argument");
+        static_assert(tab.slots[s].kind != detail::fmt_kind::none, "option has no scan format");
+        static_assert(detail::accepts<T>(tab.slots[s].kind), "type does not match the option's scan format");
+
+        const state &st = states_[s];
+        if (idx >= st.items.size()) return std::nullopt;
+        T value{};
+        if (!detail::convert(st.items[idx], value)) return std::nullopt;
+        return value;
+    }
+};
+
+// value_range - the values of an option converted to 'T' on dereference
+// Note: a value that can not be converted reads as 'T{}'
+template <typename T>
+class value_range
+#if __cplusplus >= 202002L
+    : public std::ranges::view_interface<value_range<T>>
+#endif
+{
+    const char *const *first_ = nullptr;
+    const char *const *last_ = nullptr;
+
+public:
+    class iterator {
+        const char *const *p_ = nullptr;
+
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = T;
+
+        iterator() = default;
+        explicit iterator(const char *const *p) : p_(p) {}
+
+        T operator*() const {
+            T value{};
+            if (!detail::convert(*p_, value)) return T{};
+            return value;
+        }
+        T operator[](difference_type n) const { return *(*this + n); }
+
+        iterator &operator++() { ++p_; return *this; }
+        iterator operator++(int) { iterator it = *this; ++p_; return it; }
+        iterator &operator--() { --p_; return *this; }
+        iterator operator--(int) { iterator it = *this; --p_; return it; }
+        iterator &operator+=(difference_type n) { p_ += n; return *this; }
+        iterator &operator-=(difference_type n) { p_ -= n; return *this; }
+        friend iterator operator+(iterator it, difference_type n) { return it += n; }
+        friend iterator operator+(difference_type n, iterator it) { return it += n; }
+        friend iterator operator-(iterator it, difference_type n) { return it -= n; }
+        friend difference_type operator-(iterator a, iterator b) { return a.p_ - b.p_; }
+
+        friend bool operator==(iterator a, iterator b) { return a.p_ == b.p_; }
+        friend bool operator!=(iterator a, iterator b) { return a.p_ != b.p_; }
+        friend bool operator<(iterator a, iterator b) { return a.p_ < b.p_; }
+        friend bool operator>(iterator a, iterator b) { return a.p_ > b.p_; }
+        friend bool operator<=(iterator a, iterator b) { return a.p_ <= b.p_; }
+        friend bool operator>=(iterator a, iterator b) { return a.p_ >= b.p_; }
+    };
+
+    value_range() = default;
+    value_range(const char *const *first, std::size_t len) : first_(first), last_(first + len) {}
+
+    iterator begin() const { return iterator(first_); }
+    iterator end() const { return iterator(last_); }
+    std::size_t size() const { return static_cast<std::size_t>(last_ - first_); }
+    bool empty() const { return first_ == last_; }
+};
+
+// options - RAII wrapper over a shop.h context
+// Note: each call switches to the wrapped context for the duration
+//       of the call, the accessors go through the C getters
+class options {
+    // a read may finish a lazy scan, see 'shop_lazy'
+    mutable shop_ctx_t ctx_{};
+
+    // find - the option with its values resolved, like a C getter
+    // Return: the option, nullptr if unknown
+    const shop_option_t *find(unsigned char name) const {
+        unsigned char idx = ctx_.map[name];
+        if (idx == 0) return nullptr;
+        scope s(&ctx_);
+        shop_len(name);
+        return &ctx_.options.items[idx - 1];
+    }
+
+    // scope - make the wrapped context current, restore the previous on exit
+    struct scope {
+        shop_ctx_t *prev;
+        explicit scope(shop_ctx_t *ctx) : prev(shop_switch(ctx)) {}
+        ~scope() { shop_switch(prev); }
+    };
+
+public:
+    // @opt_str: predefined option string, see 'shop_set'
+    explicit options(const char *opt_str) {
+        scope s(&ctx_);
+        shop_set(opt_str);
+    }
+
+    ~options() {
+        scope s(&ctx_);
+        shop_free();
+    }
+
+    options(const options &) = delete;
+    options &operator=(const options &) = delete;
+
+    options(options &&other) noexcept : ctx_(other.ctx_) {
+        other.ctx_ = shop_ctx_t{};
+    }
+
+    options &operator=(options &&other) noexcept {
+        if (this != &other) {
+            { scope s(&ctx_); shop_free(); }
+            ctx_ = other.ctx_;
+            other.ctx_ = shop_ctx_t{};
+        }
+        return *this;
+    }
+
+    // desc - see 'shop_desc'
+    options &desc(unsigned char name, const char *scan_fmt, const char *info) {
+        scope s(&ctx_);
+        shop_desc(name, scan_fmt, info);
+        return *this;
+    }
+
+    // bind - see 'shop_bind'
+    options &bind(unsigned char name, void *dst, const char *scan_fmt = nullptr) {
+        scope s(&ctx_);
+        shop_bind(name, dst, scan_fmt);
+        return *this;
+    }
+
+    // track - see 'shop_track'
+    void track(int argc, char **argv) {
+        scope s(&ctx_);
+        shop_track(argc, argv);
+    }
+
+    void help() {
+        scope s(&ctx_);
+        shop_help();
+    }
+
+    void verbose() {
+        scope s(&ctx_);
+        shop_verbose();
+    }
+
+    // use - check if the option is used, see 'shop_use'
+    bool use(unsigned char name) const {
+        scope s(&ctx_);
+        return shop_use(name) != nullptr;
+    }
+
+    // len - get the length of option value array, see 'shop_len'
+    std::size_t len(unsigned char name) const {
+        if (ctx_.map[name] == 0) return 0;
+        scope s(&ctx_);
+        return shop_len(name);
+    }
+
+    // value - get the raw option value, it points into argv
+    // Return: the value, or an empty view if absent or a "%range" option
+    std::string_view value(unsigned char name, std::size_t idx = 0) const {
+        scope s(&ctx_);
+        const char *value = nullptr;
+        if (!shop_get_str(name, idx, &value)) return {};
+        return value;
+    }
+
+    // get - get the option value converted to 'T'
+    // Note: a "%range" option is read as 'int' or 'long' only
+    // Return: the value, or nothing if absent or not convertible
+    template <typename T>
+    std::optional<T> get(unsigned char name, std::size_t idx = 0) const {
+        const shop_option_t *opt = find(name);
+        if (!opt) return std::nullopt;
+        scope s(&ctx_);
+        T value{};
+        if (opt->type == SHOP_RANGE) {
+            bool ok = false;
+            if constexpr (std::is_same_v<T, int>) ok = shop_get_int(name, idx, &value);
+            else if constexpr (std::is_same_v<T, long>) ok = shop_get_long(name, idx, &value);
+            if (!ok) return std::nullopt;
+            return value;
+        }
+        const char *raw = nullptr;
+        if (!shop_get_str(name, idx, &raw) || !detail::convert(raw, value)) return std::nullopt;
+        return value;
+    }
+
+    // values - the option values converted lazily to 'T'
+    // Note: not for a "%range" option, its values are not stored
+    template <typename T>
+    value_range<T> values(unsigned char name) const {
+        const shop_option_t *opt = find(name);
+        if (!opt) return {};
+        SHOP_ASSERT(opt->type != SHOP_RANGE, "option '-%c' is a range, read it with 'get'", name);
+        return value_range<T>(opt->items, opt->len);
+    }
+
+#if __cplusplus >= 202002L
+    // items - the raw option values, they point into argv
+    // Note: not for a "%range" option, see 'values'
+    std::span<const char *const> items(unsigned char name) const {
+        const shop_option_t *opt = find(name);
+        if (!opt) return {};
+        SHOP_ASSERT(opt->type != SHOP_RANGE, "option '-%c' is a range, read it with 'get'", name);
+        return {opt->items, opt->len};
+    }
+#endif
+};
+
+} // namespace shop
+
+#if __cplusplus >= 202002L
+template <typename T>
+inline constexpr bool std::ranges::enable_borrowed_range<shop::value_range<T>> = true;
+#endif
+
+#endif // SHOP_HPP
@@ -0,0 +1,58 @@
+// make test
+// checks that the first 'shop_convert_all' of a fresh pool runs its
+// tasks on as many threads as asked: each task waits for all of them
+
+#define _POSIX_C_SOURCE 200809L
+#define SHOP_IMPLEMENTATION
+#include "shop.h"
+#include <time.h>
+
+#define THREADS 4
+#define CALLS   3
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t all_in = PTHREAD_COND_INITIALIZER;
+static int arrived;
+
+// a converter that returns once THREADS values are being converted at
+// the same time, or fails after a second
+static bool conv_meet(const char *value, void *dst) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += 1;
+
+    pthread_mutex_lock(&lock);
+    arrived++;
+    pthread_cond_broadcast(&all_in);
+    int rc = 0;
+    while (arrived % THREADS != 0 && rc == 0) rc = pthread_cond_timedwait(&all_in, &lock, &deadline);
+    pthread_mutex_unlock(&lock);
+
+    *((int *) dst) = atoi(value);
+    return rc == 0;
+}
+
+int main(void) {
+    shop_type_t meet = shop_register_type("%meet", conv_meet, sizeof(int));
+
+    char *argv[1 + 2*THREADS];
+    argv[0] = "test_convert";
+    for (int i = 0; i < THREADS; i++) {
+        argv[1 + 2*i] = "-n";
+        argv[2 + 2*i] = "7";
+    }
+    shop_set("n:");
+    shop_desc('n', "%s", "Values");
+    shop_track(1 + 2*THREADS, argv);
+
+    int failed = 0;
+    for (int c = 0; c < CALLS; c++) {
+        int out[THREADS];
+        // one value per task, a task waits for the others
+        size_t bad = shop_convert_all('n', meet, out, THREADS, NULL, THREADS);
+        printf("call %d: %zu of %d tasks did not meet the others\n", c + 1, bad, THREADS);
+        if (bad) failed++;
+    }
+    shop_free();
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,101 @@
+// make test
+// checks 'shop_threads' against the sequential scan on random argvs:
+// the same values, counts, events and exit status
+
+#define _POSIX_C_SOURCE 200809L
+#include <sys/wait.h>
+#include <unistd.h>
+
+// small chunks, so short argvs are split too
+#define SHOP_CHUNK 4
+#define SHOP_IMPLEMENTATION
+#include "shop.h"
+
+#define RUNS 3000
+#define MAX_ARGS 64
+#define OUT_SIZE 8192
+
+// flags, combined, attached and split values, missing arguments
+static const char *tokens[] = {
+    "-n", "-vn", "-v", "x", "-ny", "-l", "-lq", "-f", "-ff", "-c", "-vc", "-", "pos", "-cv",
+};
+#define NTOKENS (sizeof(tokens)/sizeof(tokens[0]))
+
+static void setup(int threads) {
+    shop_set("vn:l:f:c");
+    shop_mode('l', SHOP_LAST);
+    shop_mode('f', SHOP_FIRST);
+    shop_mode('c', SHOP_COUNT);
+    shop_events(true);
+    shop_threads(threads);
+}
+
+static void dump(FILE *out) {
+    const char *names = "vnlfc";
+    for (const char *c = names; *c; c++) {
+        fprintf(out, "%c used=%d count=%zu len=%zu:", *c, shop_use(*c) != NULL, shop_count(*c), shop_len(*c));
+        for (size_t i = 0; i < shop_len(*c); i++) {
+            const char *value;
+            shop_get_str(*c, i, &value);
+            fprintf(out, " %s", value);
+        }
+        fprintf(out, "\n");
+    }
+    size_t len;
+    const shop_event_t *events = shop_event_log(&len);
+    for (size_t i = 0; i < len; i++) {
+        fprintf(out, "%c%d@%u ", events[i].name, (int) events[i].value, events[i].arg);
+    }
+    fprintf(out, "\n");
+}
+
+// run 'shop_track' in a child and read back its dump
+static int track(int threads, int argc, char **argv, char *buf) {
+    FILE *tmp = tmpfile();
+    if (!tmp) return -1;
+    // an error exits the child, which flushes what it inherited
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        fclose(stderr);
+        setup(threads);
+        shop_track(argc, argv);
+        dump(tmp);
+        fflush(tmp);
+        _exit(0);
+    }
+    int status = -1;
+    waitpid(pid, &status, 0);
+    rewind(tmp);
+    size_t len = fread(buf, 1, OUT_SIZE - 1, tmp);
+    buf[len] = '\0';
+    fclose(tmp);
+    return status;
+}
+
+int main(void) {
+    srand(1);
+    int failed = 0;
+    for (int r = 0; r < RUNS; r++) {
+        char *argv[MAX_ARGS];
+        int argc = 1 + rand() % (MAX_ARGS - 4);
+        argv[0] = "test_track";
+        for (int i = 1; i < argc; i++) argv[i] = (char *) tokens[rand() % NTOKENS];
+        argv[argc] = NULL;
+
+        int threads = 2 + rand() % 7;
+        static char seq[OUT_SIZE], par[OUT_SIZE];
+        int seq_status = track(1, argc, argv, seq);
+        int par_status = track(threads, argc, argv, par);
+        if (seq_status == par_status && strcmp(seq, par) == 0) continue;
+
+        if (failed++ < 3) {
+            printf("FAIL with %d threads, status %d vs %d:", threads, seq_status, par_status);
+            for (int i = 1; i < argc; i++) printf(" %s", argv[i]);
+            printf("\n%s---\n%s\n", seq, par);
+        }
+    }
+
+    printf("%d/%d argvs differ from the sequential scan\n", failed, RUNS);
+    return failed ? 1 : 0;
+}
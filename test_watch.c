@@ -0,0 +1,65 @@
+// make test
+// checks that 'shop_watch' picks up a rewritten file, and that a file
+// with an invalid value keeps the previous snapshot instead of exiting
+
+#define _POSIX_C_SOURCE 200809L
+#define SHOP_WATCH
+#define SHOP_IMPLEMENTATION
+#include "shop.h"
+
+#define PATH "test_watch.ini"
+
+static void setup(void) {
+    shop_set("n:");
+    shop_desc('n', "%d", "Number");
+}
+
+// replace the file by a rename, like an editor does
+static void write_config(const char *text) {
+    FILE *f = fopen(PATH ".tmp", "w");
+    if (!f) exit(EXIT_FAILURE);
+    fputs(text, f);
+    fclose(f);
+    rename(PATH ".tmp", PATH);
+}
+
+static int read_n(void) {
+    shop_ctx_t *prev = shop_acquire();
+    int n = -1;
+    shop_get_int('n', 0, &n);
+    shop_release(prev);
+    return n;
+}
+
+// wait up to a second for 'n' to become 'want'
+static bool wait_n(int want) {
+    for (int i = 0; i < 100 && read_n() != want; i++) poll(NULL, 0, 10);
+    return read_n() == want;
+}
+
+int main(void) {
+    char *argv[] = { "test_watch", NULL };
+    int failed = 0;
+
+    write_config("n = 1\n");
+    if (!shop_watch(PATH, NULL, setup, 1, argv)) return 1;
+    if (read_n() != 1) failed++;
+
+    write_config("n = 2\n");
+    if (!wait_n(2)) failed++;
+    printf("reload: n = %d\n", read_n());
+
+    // reported on stderr, the old snapshot stays
+    write_config("n = two\n");
+    poll(NULL, 0, 200);
+    if (read_n() != 2) failed++;
+    printf("invalid value: n = %d\n", read_n());
+
+    write_config("n = 3\n");
+    if (!wait_n(3)) failed++;
+    printf("reload after it: n = %d\n", read_n());
+
+    shop_unwatch();
+    remove(PATH);
+    return failed ? 1 : 0;
+}